@@ -1,178 +1,479 @@
-#include <windows.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <mutex>
 #include <string>
-
-struct Record {
+#include <vector>
+#include "mapped_file.h"
+#include "name_heap.h"
+#include "record.h"
+#include "record_index.h"
+#include "record_scan.h"
+#include "wal.h"
+
+// Layout of database2.bin before names moved to the heap; such files carry
+// no header and are migrated on open.
+struct LegacyRecord {
     int id;
     char name[50];
 };
 
-HANDLE CreateAndMapFile(LPCSTR filename, DWORD size, HANDLE &hFile, LPVOID &mappedView) {
-    hFile = CreateFile(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (hFile == INVALID_HANDLE_VALUE) {
-        std::cerr << "Failed to create file" << std::endl;
-        return NULL;
+// The record file starts with this header, followed by the slots.
+struct RecordFileHeader {
+    uint32_t magic;
+    uint32_t recordSize;
+};
+
+const uint32_t RECORD_FILE_MAGIC = 0x32434552; // "REC2"
+
+size_t RecordFileSize(int records) {
+    return sizeof(RecordFileHeader) + sizeof(Record) * static_cast<size_t>(records);
+}
+
+// The record file, the name heap, the id index and the write-ahead log
+// protecting them. The record file and name heap are mapped copy-on-write,
+// so a change reaches them only through a checkpoint, after its log entry is
+// durable. The index is rebuilt from the records whenever the log was not
+// closed cleanly.
+struct RecordStore {
+    MappedFile file;
+    NameHeap names;
+    RecordIndex index;
+    WriteAheadLog log;
+    std::mutex mutex;
+    int recordCount = 0;
+    int maxRecords = 0;
+    int minRecords = 0;
+    size_t checkpointBytes = 4 * 1024 * 1024;
+    // Repeated names share one copy in the heap.
+    bool dictionaryNames = true;
+    // Set when a logged change could not be applied. Memory then no longer
+    // matches the log, so no further change is accepted.
+    bool failed = false;
+
+    Record* records() const {
+        return reinterpret_cast<Record*>(static_cast<char*>(file.data()) + sizeof(RecordFileHeader));
     }
+    const char* name(const Record &record) const { return names.Get(record.name); }
+};
 
-    if (SetFilePointer(hFile, size, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER && GetLastError() != NO_ERROR) {
-        std::cerr << "Failed to set file pointer with error: " << GetLastError() << std::endl;
-        CloseHandle(hFile);
-        return NULL;
+// After-image of one slot; a log entry is a LogHeader followed by imageCount
+// of these, each followed by nameLength bytes of name.
+struct LogImage {
+    int32_t slot;
+    int32_t id;
+    uint32_t nameLength;
+};
+
+struct LogHeader {
+    int32_t recordCount;
+    int32_t imageCount;
+};
+
+// Redo entry: after-images of the slots an operation changes and the record
+// count after it. Full images, names included, make replay idempotent, so a
+// crash between a checkpoint and the log truncation is harmless.
+struct LogEntry {
+    std::vector<char> bytes;
+
+    explicit LogEntry(int recordCount) {
+        LogHeader header{recordCount, 0};
+        Append(&header, sizeof(header));
     }
-    if (!SetEndOfFile(hFile)) {
-        std::cerr << "Failed to set end of file with error: " << GetLastError() << std::endl;
-        CloseHandle(hFile);
-        return NULL;
+
+    int recordCount() const { return reinterpret_cast<const LogHeader*>(bytes.data())->recordCount; }
+    int imageCount() const { return reinterpret_cast<const LogHeader*>(bytes.data())->imageCount; }
+
+    void AddImage(int slot, int id, const char* name, size_t nameLength) {
+        nameLength = std::min(nameLength, NameHeap::MAX_NAME);
+        LogImage image{slot, id, static_cast<uint32_t>(nameLength)};
+        Append(&image, sizeof(image));
+        Append(name, nameLength);
+        reinterpret_cast<LogHeader*>(bytes.data())->imageCount++;
     }
 
-    HANDLE hMapFile = CreateFileMapping(hFile, NULL, PAGE_READWRITE, 0, size, NULL);
-    if (!hMapFile) {
-        std::cerr << "Failed to create file mapping" << std::endl;
-        CloseHandle(hFile);
-        return NULL;
+private:
+    void Append(const void* data, size_t size) {
+        bytes.insert(bytes.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
     }
+};
 
-    mappedView = MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, size);
-    if (!mappedView) {
-        std::cerr << "Failed to map file view" << std::endl;
-        CloseHandle(hMapFile);
-        CloseHandle(hFile);
-        return NULL;
+void ManageFileSize(RecordStore &store);
+bool EnsureCapacity(RecordStore &store, int records);
+
+// The index is updated together with the records: an id overwritten in
+// place is dropped, and the new id points at slot.
+bool ApplyImage(RecordStore &store, const LogImage &image, const char* name) {
+    uint32_t nameRef = store.names.Store(name, image.nameLength);
+    if (nameRef == 0) {
+        std::cerr << "Failed to store the name." << std::endl;
+        return false;
     }
 
-    return hMapFile;
+    Record* records = store.records();
+    int slot = image.slot;
+    if (records[slot].id != image.id && store.index.Get(records[slot].id) == slot) {
+        store.index.Erase(records[slot].id);
+    }
+    if (image.id != -1 && !store.index.Put(image.id, slot)) {
+        std::cerr << "Failed to grow the index." << std::endl;
+        return false;
+    }
+    records[slot] = {image.id, nameRef};
+    store.file.MarkDirty(RecordFileSize(slot), sizeof(Record));
+    return true;
 }
 
-void WriteRecord(LPVOID mappedView, int index, int id, const char* name) {
-    Record* records = static_cast<Record*>(mappedView);
-    records[index].id = id;
-    strncpy(records[index].name, name, sizeof(records[index].name) - 1);
-    records[index].name[sizeof(records[index].name) - 1] = '\0';
+// Checks the framing of a serialised entry and applies it.
+bool ApplyEntry(RecordStore &store, const char* bytes, size_t size) {
+    LogHeader header;
+    if (size < sizeof(header)) return false;
+    memcpy(&header, bytes, sizeof(header));
+    if (header.recordCount < 0 || header.imageCount < 0) return false;
+
+    size_t offset = sizeof(header);
+    for (int i = 0; i < header.imageCount; i++) {
+        LogImage image;
+        if (size - offset < sizeof(image)) return false;
+        memcpy(&image, bytes + offset, sizeof(image));
+        offset += sizeof(image);
+        if (image.slot < 0 || size - offset < image.nameLength) return false;
+
+        if (!EnsureCapacity(store, image.slot + 1) || !ApplyImage(store, image, bytes + offset)) return false;
+        offset += image.nameLength;
+    }
+    store.recordCount = header.recordCount;
+    ManageFileSize(store);
+    return true;
 }
 
-void DeleteRecord(LPVOID mappedView, int index, int &recordCount) {
-    if (recordCount <= 0 || index >= recordCount) {
-        std::cerr << "Invalid index or no records to delete." << std::endl;
-        return;
+bool Checkpoint(RecordStore &store) {
+    return store.log.WaitDurable(store.log.lastLsn()) && store.names.Flush() && store.file.Flush() &&
+           store.log.Checkpoint(static_cast<uint64_t>(store.recordCount));
+}
+
+// Logs entry, applies it and, once the log has grown past checkpointBytes,
+// checkpoints. Called with the store mutex held; returns the LSN to wait
+// for, or 0 on failure. The record file and the index are grown before the
+// entry is logged, so a full disk rejects the change instead of leaving it
+// in the log.
+uint64_t LogAndApply(RecordStore &store, const LogEntry &entry) {
+    if (store.failed) {
+        std::cerr << "The store no longer matches its log; reopen it." << std::endl;
+        return 0;
+    }
+    if (!EnsureCapacity(store, entry.recordCount())) return 0;
+    if (!store.index.Reserve(entry.imageCount())) {
+        std::cerr << "Failed to grow the index." << std::endl;
+        return 0;
     }
 
-    Record* records = static_cast<Record*>(mappedView);
+    uint64_t lsn = store.log.Append(entry.bytes.data(), entry.bytes.size());
+    if (lsn == 0) {
+        std::cerr << "Failed to log the change." << std::endl;
+        return 0;
+    }
+    if (!ApplyEntry(store, entry.bytes.data(), entry.bytes.size())) {
+        std::cerr << "Failed to apply the logged change." << std::endl;
+        store.failed = true;
+        return 0;
+    }
+    if (store.log.size() >= store.checkpointBytes && !Checkpoint(store)) {
+        std::cerr << "Checkpoint failed." << std::endl;
+    }
+    return lsn;
+}
 
-    if (index != recordCount - 1) {
-        records[index] = records[recordCount - 1];
+// Logs and applies a write of slot index with the store mutex held.
+uint64_t LogWrite(RecordStore &store, int index, int id, const char* name) {
+    if (index < 0 || index > store.recordCount) {
+        std::cerr << "Invalid index." << std::endl;
+        return 0;
     }
 
-    records[recordCount - 1].id = -1;
-    strcpy(records[recordCount - 1].name, "");
+    LogEntry entry(std::max(store.recordCount, index + 1));
+    entry.AddImage(index, id, name, strlen(name));
+    return LogAndApply(store, entry);
+}
 
-    recordCount--;
+// Writes slot index, which may be one past the last record to append. Returns
+// once the change is durable.
+bool WriteRecord(RecordStore &store, int index, int id, const char* name) {
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(store.mutex);
+        lsn = LogWrite(store, index, id, name);
+    }
+    return lsn != 0 && store.log.WaitDurable(lsn);
 }
 
+// Updates the record with this id in place, or appends it.
+bool PutRecord(RecordStore &store, int id, const char* name) {
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(store.mutex);
+        int index = store.index.Get(id);
+        lsn = LogWrite(store, index == RecordIndex::NOT_FOUND ? store.recordCount : index, id, name);
+    }
+    return lsn != 0 && store.log.WaitDurable(lsn);
+}
 
-HANDLE ResizeFileMapping(HANDLE hFile, HANDLE hMapFile, LPVOID &mappedView, DWORD newSize) {
+bool DeleteRecord(RecordStore &store, int index) {
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(store.mutex);
+        if (store.recordCount <= 0 || index < 0 || index >= store.recordCount) {
+            std::cerr << "Invalid index or no records to delete." << std::endl;
+            return false;
+        }
 
-    if (!UnmapViewOfFile(mappedView)) {
-        std::cerr << "Failed to unmap view of file with error: " << GetLastError() << std::endl;
-        return NULL;
+        int last = store.recordCount - 1;
+        LogEntry entry(last);
+        if (index != last) {
+            const Record &moved = store.records()[last];
+            const char* movedName = store.name(moved);
+            entry.AddImage(index, moved.id, movedName, strlen(movedName));
+        }
+        entry.AddImage(last, -1, "", 0);
+        lsn = LogAndApply(store, entry);
     }
-    CloseHandle(hMapFile);
+    return lsn != 0 && store.log.WaitDurable(lsn);
+}
 
-    if (SetFilePointer(hFile, newSize, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER && GetLastError() != NO_ERROR) {
-        std::cerr << "Failed to set file pointer with error: " << GetLastError() << std::endl;
-        return NULL;
-    }
+Record* FindRecord(RecordStore &store, int id) {
+    int index = store.index.Get(id);
+    return index == RecordIndex::NOT_FOUND ? nullptr : &store.records()[index];
+}
 
-    if (!SetEndOfFile(hFile)) {
-        std::cerr << "Failed to set end of file with error: " << GetLastError() << std::endl;
-        return NULL;
+// Runs query over the live records and returns the number of matches; with
+// rows, also appends their slots. The store mutex is held throughout, so no
+// write or resize moves the records under the scan. The record range is
+// advised as sequential and prefetched for the scan, then set back to normal
+// for the index lookups that usually follow.
+size_t ScanStore(RecordStore &store, const ScanQuery &query, std::vector<uint32_t>* rows = nullptr) {
+    std::lock_guard<std::mutex> lock(store.mutex);
+    size_t bytes = sizeof(Record) * static_cast<size_t>(store.recordCount);
+    store.file.Advise(sizeof(RecordFileHeader), bytes, MappedFile::Sequential);
+    store.file.Advise(sizeof(RecordFileHeader), bytes, MappedFile::WillNeed);
+    size_t matches = ScanRecords(store.records(), static_cast<size_t>(store.recordCount), store.names, query, rows);
+    store.file.Advise(sizeof(RecordFileHeader), bytes, MappedFile::Normal);
+    return matches;
+}
+
+// Capacity doubles when the file is full and halves only once it is a
+// quarter full, never below minRecords. The gap between the two thresholds
+// keeps a store hovering around one size from resizing on every operation.
+void ManageFileSize(RecordStore &store) {
+    int maxRecords = store.maxRecords;
+    int newMaxRecords = maxRecords;
+    if (store.recordCount >= maxRecords) {
+        newMaxRecords = maxRecords * 2;
+    } else if (store.recordCount < maxRecords / 4 && maxRecords / 2 >= store.minRecords) {
+        newMaxRecords = maxRecords / 2;
+    } else {
+        return;
     }
 
+    if (!store.file.Resize(RecordFileSize(newMaxRecords))) {
+        std::cerr << (newMaxRecords > maxRecords ? "Failed to resize the file!" : "Failed to shrink the file!") << std::endl;
+        return;
+    }
+    std::cout << (newMaxRecords > maxRecords ? "File resized" : "File shrunk") << ". New limit: "
+              << newMaxRecords << " records." << std::endl;
+    store.maxRecords = newMaxRecords;
+}
 
-    hMapFile = CreateFileMapping(hFile, NULL, PAGE_READWRITE, 0, newSize, NULL);
-    if (hMapFile == NULL) {
-        std::cerr << "CreateFileMapping failed with error: " << GetLastError() << std::endl;
-        return NULL;
+// Grows the file until it holds at least records slots. Replay needs this
+// when the file was shrunk after the checkpoint it starts from.
+bool EnsureCapacity(RecordStore &store, int records) {
+    int newMaxRecords = std::max(store.maxRecords, 1);
+    while (newMaxRecords < records) newMaxRecords *= 2;
+    if (newMaxRecords == store.maxRecords) return true;
+    if (!store.file.Resize(RecordFileSize(newMaxRecords))) {
+        std::cerr << "Failed to resize the file!" << std::endl;
+        return false;
     }
+    store.maxRecords = newMaxRecords;
+    return true;
+}
 
+// Opens the store, replaying the log over the last checkpoint. With
+// MappedFile::Truncate in flags any existing store at path is discarded.
+bool OpenStore(RecordStore &store, const std::string &path, int minRecords, unsigned flags = 0) {
+    store.minRecords = minRecords;
+    if (flags & MappedFile::Truncate) std::filesystem::remove(path + ".wal");
+    if (!store.log.Open((path + ".wal").c_str())) return false;
+    bool clean = store.log.WasClean();
+    store.recordCount = static_cast<int>(store.log.checkpointState());
+
+    unsigned mapFlags = flags | MappedFile::CopyOnWrite;
+    if (!store.file.Open((path + ".bin").c_str(), RecordFileSize(minRecords), mapFlags)) return false;
+    auto* header = static_cast<RecordFileHeader*>(store.file.data());
+    if (header->magic != RECORD_FILE_MAGIC) {
+        if (store.recordCount != 0 || header->magic != 0) {
+            std::cerr << "Unrecognised record file." << std::endl;
+            return false;
+        }
+        *header = {RECORD_FILE_MAGIC, sizeof(Record)};
+        store.file.MarkDirty(0, sizeof(RecordFileHeader));
+    }
+    store.maxRecords = static_cast<int>((store.file.size() - sizeof(RecordFileHeader)) / sizeof(Record));
+    if (!EnsureCapacity(store, store.recordCount)) return false;
+
+    if (!store.names.Open((path + ".names").c_str(), mapFlags, store.dictionaryNames)) return false;
+
+    bool indexValid = clean && store.index.Reopen((path + ".idx").c_str());
+    if (!indexValid && !store.index.Open((path + ".idx").c_str(), store.maxRecords)) return false;
+
+    int replayed = 0;
+    bool recovered = store.log.Recover([&](const void* payload, size_t size) {
+        if (!ApplyEntry(store, static_cast<const char*>(payload), size)) return false;
+        replayed++;
+        return true;
+    });
+    if (!recovered) {
+        std::cerr << "Failed to replay the log." << std::endl;
+        return false;
+    }
 
-    mappedView = MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, newSize);
-    if (!mappedView) {
-        std::cerr << "Failed to map view of file with error: " << GetLastError() << std::endl;
-        CloseHandle(hMapFile);
-        return NULL;
+    if (!indexValid) {
+        for (int i = 0; i < store.recordCount; i++) {
+            if (!store.index.Put(store.records()[i].id, i)) {
+                std::cerr << "Failed to rebuild the index." << std::endl;
+                return false;
+            }
+        }
     }
+    if (replayed > 0) {
+        std::cout << "Replayed " << replayed << " log entries." << std::endl;
+    }
+    return true;
+}
 
-    return hMapFile;
+void CloseStore(RecordStore &store) {
+    bool ok = Checkpoint(store) && store.index.Flush();
+    store.log.Close(ok);
+    store.index.Close();
+    store.names.Close();
+    store.file.Close();
 }
 
+// True for a database2.bin in the headerless layout of LegacyRecord.
+bool IsLegacyFile(const std::string &filename) {
+    std::error_code error;
+    auto size = std::filesystem::file_size(filename, error);
+    if (error || size == 0 || size % sizeof(LegacyRecord) != 0) return false;
 
-void ManageFileSize(HANDLE hFile, HANDLE &hMapFile, LPVOID &mappedView, int &recordCount, int &maxRecords) {
-    const int increaseStep = static_cast<int>(maxRecords / 2);
-    DWORD newSize;
+    MappedFile file;
+    if (!file.Open(filename.c_str(), 0, 0)) return false;
+    return static_cast<const RecordFileHeader*>(file.data())->magic != RECORD_FILE_MAGIC;
+}
 
-    if (recordCount >= maxRecords) {
-        newSize = sizeof(Record) * (maxRecords + increaseStep);
-        hMapFile = ResizeFileMapping(hFile, hMapFile, mappedView, newSize);
-        if (hMapFile) {
-            maxRecords += increaseStep;
-            std::cout << "File resized. New limit: " << maxRecords << " records." << std::endl;
-        } else {
-            std::cerr << "Failed to resize the file!" << std::endl;
-            return;
+// Converts a legacy database2.bin into the slot + name heap layout.
+//
+// The new store is built under a temporary name and closed cleanly before
+// any file is replaced. The legacy file is kept as path.bin.legacy, and the
+// new files are renamed into place with path.bin last. A migration
+// interrupted at any point leaves either the legacy file in place or
+// path.bin missing next to path.bin.legacy, and main then runs it again.
+//
+// The old layout has no record count: slots with an empty name are either
+// deleted (id -1) or were never written, so only named slots are carried over.
+bool MigrateLegacyStore(const std::string &path, int minRecords) {
+    std::string legacyPath = path + ".bin.legacy";
+    if (!std::filesystem::exists(legacyPath)) std::filesystem::rename(path + ".bin", legacyPath);
+
+    std::vector<LegacyRecord> legacy;
+    {
+        MappedFile file;
+        if (!file.Open(legacyPath.c_str(), 0, 0)) return false;
+        const auto* records = static_cast<const LegacyRecord*>(file.data());
+        for (size_t i = 0; i < file.size() / sizeof(LegacyRecord); i++) {
+            if (records[i].name[0] != '\0') legacy.push_back(records[i]);
         }
     }
 
-
-    if (recordCount < maxRecords / 2 && maxRecords > increaseStep) {
-        newSize = sizeof(Record) * (maxRecords - increaseStep);
-        hMapFile = ResizeFileMapping(hFile, hMapFile, mappedView, newSize);
-        if (hMapFile) {
-            maxRecords -= increaseStep;
-            std::cout << "File shrunk. New limit: " << maxRecords << " records." << std::endl;
-        } else {
-            std::cerr << "Failed to shrink the file!" << std::endl;
-            return;
+    std::string temporary = path + ".migrating";
+    {
+        RecordStore store;
+        if (!OpenStore(store, temporary, minRecords, MappedFile::Truncate)) return false;
+        std::lock_guard<std::mutex> lock(store.mutex);
+        for (const LegacyRecord &record : legacy) {
+            std::string name(record.name, strnlen(record.name, sizeof(record.name)));
+            if (LogWrite(store, store.recordCount, record.id, name.c_str()) == 0) return false;
         }
+        CloseStore(store);
+    }
+
+    for (const char* extension : {".names", ".idx", ".wal", ".bin"}) {
+        std::filesystem::rename(temporary + extension, path + extension);
     }
+    std::cout << "Migrated " << legacy.size() << " records from the fixed-size layout; the old file is kept as "
+              << legacyPath << "." << std::endl;
+    return true;
 }
 
 int main() {
-    LPVOID mappedView;
-    HANDLE hFile;
-    int maxRecords = 10;
-    const DWORD initialSize = sizeof(Record) * maxRecords;
+    const int initialRecords = 10;
+    const std::string path = "database2";
 
-    HANDLE hMapFile = CreateAndMapFile("database2.bin", initialSize, hFile, mappedView);
+    bool interrupted = !std::filesystem::exists(path + ".bin") && std::filesystem::exists(path + ".bin.legacy");
+    if ((interrupted || IsLegacyFile(path + ".bin")) && !MigrateLegacyStore(path, initialRecords)) {
+        std::cerr << "Failed to migrate " << path << ".bin" << std::endl;
+        return 1;
+    }
 
-    if (hMapFile) {
-        int recordCount = 0;
+    RecordStore store;
+    if (OpenStore(store, path, initialRecords)) {
+        std::cout << "Opened store with " << store.recordCount << " records." << std::endl;
 
         for(int i = 0; i < 20; i++) {
-            WriteRecord(mappedView, recordCount++, i, "Object");
-            std::cout << "Record added. Total records: " << recordCount << std::endl;
-            ManageFileSize(hFile, hMapFile, mappedView, recordCount, maxRecords);
+            PutRecord(store, i, "Object");
+            std::cout << "Record added. Total records: " << store.recordCount << std::endl;
         }
 
+        ScanQuery range;
+        range.minId = 5;
+        range.maxId = 14;
+        ScanQuery prefixed;
+        prefixed.nameMatch = ScanQuery::NamePrefix;
+        prefixed.name = "Obj";
+        std::vector<uint32_t> rows;
+        std::cout << "Scan (" << ScanKernelName() << "): " << ScanStore(store, range) << " records with ID 5-14, "
+                  << ScanStore(store, prefixed, &rows) << " with a name starting with \"Obj\"";
+        if (!rows.empty()) std::cout << ", first in slot " << rows.front();
+        std::cout << "." << std::endl;
+
         std::cout << "Before deletion:" << std::endl;
-        Record* records = static_cast<Record*>(mappedView);
-        for (int i = 0; i < recordCount; i++) {
-            std::cout << "ID: " << records[i].id << ", Name: " << records[i].name << std::endl;
+        Record* records = store.records();
+        for (int i = 0; i < store.recordCount; i++) {
+            std::cout << "ID: " << records[i].id << ", Name: " << store.name(records[i]) << std::endl;
         }
 
-        for(int i = 0; i < recordCount; i++) {
-            DeleteRecord(mappedView, i, recordCount);
-            std::cout << "Record deleted. Total records: " << recordCount << std::endl;
-            ManageFileSize(hFile, hMapFile, mappedView, recordCount, maxRecords);
+        for(int i = 0; i < store.recordCount; i++) {
+            DeleteRecord(store, i);
+            std::cout << "Record deleted. Total records: " << store.recordCount << std::endl;
         }
 
         std::cout << "After deletion:" << std::endl;
-        for (int i = 0; i < recordCount; i++) {
-            std::cout << "ID: " << records[i].id << ", Name: " << records[i].name << std::endl;
+        records = store.records();
+        for (int i = 0; i < store.recordCount; i++) {
+            std::cout << "ID: " << records[i].id << ", Name: " << store.name(records[i]) << std::endl;
+        }
+
+        for (int id : {0, 5, 19}) {
+            Record* record = FindRecord(store, id);
+            if (record) {
+                std::cout << "Lookup ID " << id << ": slot " << record - records << ", Name: " << store.name(*record) << std::endl;
+            } else {
+                std::cout << "Lookup ID " << id << ": not found" << std::endl;
+            }
         }
+        std::cout << "Name heap: " << store.names.used() << " bytes." << std::endl;
 
-        UnmapViewOfFile(mappedView);
-        CloseHandle(hMapFile);
-        CloseHandle(hFile);
+        CloseStore(store);
     }
 
     return 0;
@@ -0,0 +1,400 @@
+#ifndef DATABASE_MAPPED_FILE_H
+#define DATABASE_MAPPED_FILE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// A file mapped read-write into memory that can grow and shrink.
+//
+// On Linux a large range of address space is reserved once with PROT_NONE
+// and the file is mapped at its start. Growing extends the file and maps only
+// the new pages over the reservation, and shrinking hands the tail back to
+// it, so data() never changes and pointers into the file stay valid.
+//
+// On Windows a resize unmaps the view, extends the file and maps it again,
+// so data() may move.
+//
+// With CopyOnWrite the mapping is private: stores never reach the file on
+// their own, only the ranges passed to MarkDirty are written back by Flush.
+// This lets a write-ahead log decide when data pages become durable.
+class MappedFile {
+public:
+    // Address space reserved per file; the file cannot grow past it.
+    static const size_t RESERVED_BYTES = sizeof(void *) == 8 ? size_t(1) << 36 : size_t(1) << 28;
+
+    enum OpenFlags : unsigned {
+        // Discard existing contents; otherwise the file keeps its data and
+        // is only grown to the requested size.
+        Truncate = 1,
+        CopyOnWrite = 2
+    };
+
+    // Expected access to a range, passed on to the kernel's readahead.
+    enum AccessHint {
+        Normal,
+        Sequential,
+        WillNeed
+    };
+
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { Close(); }
+
+    // Creates or opens filename with at least size bytes and maps it.
+    bool Open(const char *filename, size_t size, unsigned flags = Truncate);
+    bool Resize(size_t newSize);
+    void Close();
+
+    void MarkDirty(size_t offset, size_t length);
+    // A hint only: failures are ignored. Windows acts on WillNeed alone.
+    void Advise(size_t offset, size_t length, AccessHint hint);
+    // Writes modified pages back and waits until they are on disk.
+    bool Flush();
+
+    void *data() const { return view; }
+    size_t size() const { return fileSize; }
+
+private:
+    size_t fileSize = 0;
+    void *view = nullptr;
+    bool copyOnWrite = false;
+    // One flag per page of a copy-on-write mapping.
+    std::vector<bool> dirtyPages;
+
+    static size_t PageSize();
+#ifdef _WIN32
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMapFile = NULL;
+
+    bool SetFileSize(size_t size);
+    bool MapView(size_t size);
+#else
+    int fd = -1;
+    size_t mappedBytes = 0;
+
+    static size_t PageAlign(size_t bytes) {
+        size_t page = PageSize();
+        return (bytes + page - 1) / page * page;
+    }
+    bool SetFileSize(size_t size);
+    bool MapPages(size_t offset, size_t length);
+#endif
+    bool WritePage(size_t offset, size_t length);
+};
+
+inline void MappedFile::MarkDirty(size_t offset, size_t length) {
+    if (!copyOnWrite || length == 0) return;
+    size_t last = (offset + length - 1) / PageSize();
+    if (dirtyPages.size() <= last) dirtyPages.resize(last + 1);
+    for (size_t page = offset / PageSize(); page <= last; ++page) dirtyPages[page] = true;
+}
+
+#ifdef _WIN32
+
+inline size_t MappedFile::PageSize() {
+    static const size_t pageSize = [] {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return static_cast<size_t>(info.dwPageSize);
+    }();
+    return pageSize;
+}
+
+inline bool MappedFile::SetFileSize(size_t size) {
+    LARGE_INTEGER distance;
+    distance.QuadPart = static_cast<LONGLONG>(size);
+    if (!SetFilePointerEx(hFile, distance, NULL, FILE_BEGIN)) {
+        std::cerr << "Failed to set file pointer with error: " << GetLastError() << std::endl;
+        return false;
+    }
+    if (!SetEndOfFile(hFile)) {
+        std::cerr << "Failed to set end of file with error: " << GetLastError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool MappedFile::MapView(size_t size) {
+    hMapFile = CreateFileMapping(hFile, NULL, PAGE_READWRITE, static_cast<DWORD>(static_cast<unsigned long long>(size) >> 32),
+                                 static_cast<DWORD>(size), NULL);
+    if (!hMapFile) {
+        std::cerr << "CreateFileMapping failed with error: " << GetLastError() << std::endl;
+        return false;
+    }
+    view = MapViewOfFile(hMapFile, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!view) {
+        std::cerr << "Failed to map view of file with error: " << GetLastError() << std::endl;
+        CloseHandle(hMapFile);
+        hMapFile = NULL;
+        return false;
+    }
+    return true;
+}
+
+inline bool MappedFile::Open(const char *filename, size_t size, unsigned flags) {
+    Close();
+    copyOnWrite = (flags & CopyOnWrite) != 0;
+    hFile = CreateFile(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, (flags & Truncate) ? CREATE_ALWAYS : OPEN_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to create file" << std::endl;
+        return false;
+    }
+    LARGE_INTEGER existing;
+    if (GetFileSizeEx(hFile, &existing)) size = std::max(size, static_cast<size_t>(existing.QuadPart));
+    if (!SetFileSize(size) || !MapView(size)) {
+        Close();
+        return false;
+    }
+    fileSize = size;
+    return true;
+}
+
+inline bool MappedFile::Resize(size_t newSize) {
+    // A private view's unflushed pages would be lost with the view, so they
+    // are carried over into the new one.
+    std::vector<char> saved;
+    if (copyOnWrite) saved.assign(static_cast<char *>(view), static_cast<char *>(view) + std::min(fileSize, newSize));
+
+    if (!UnmapViewOfFile(view)) {
+        std::cerr << "Failed to unmap view of file with error: " << GetLastError() << std::endl;
+        return false;
+    }
+    view = nullptr;
+    CloseHandle(hMapFile);
+    hMapFile = NULL;
+
+    if (!SetFileSize(newSize) || !MapView(newSize)) return false;
+    std::copy(saved.begin(), saved.end(), static_cast<char *>(view));
+    fileSize = newSize;
+    return true;
+}
+
+// PrefetchVirtualMemory needs Windows 8; older targets get no hint at all.
+inline void MappedFile::Advise(size_t offset, size_t length, AccessHint hint) {
+#if _WIN32_WINNT >= 0x0602
+    if (hint != WillNeed || offset >= fileSize) return;
+    WIN32_MEMORY_RANGE_ENTRY range{static_cast<char *>(view) + offset, std::min(length, fileSize - offset)};
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    (void) offset;
+    (void) length;
+    (void) hint;
+#endif
+}
+
+inline bool MappedFile::WritePage(size_t offset, size_t length) {
+    LARGE_INTEGER distance;
+    distance.QuadPart = static_cast<LONGLONG>(offset);
+    DWORD written = 0;
+    if (!SetFilePointerEx(hFile, distance, NULL, FILE_BEGIN) ||
+        !WriteFile(hFile, static_cast<char *>(view) + offset, static_cast<DWORD>(length), &written, NULL) ||
+        written != length) {
+        std::cerr << "Failed to write page with error: " << GetLastError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool MappedFile::Flush() {
+    if (!copyOnWrite && !FlushViewOfFile(view, fileSize)) {
+        std::cerr << "Failed to flush view with error: " << GetLastError() << std::endl;
+        return false;
+    }
+    for (size_t page = 0; page < dirtyPages.size(); ++page) {
+        size_t offset = page * PageSize();
+        if (!dirtyPages[page] || offset >= fileSize) continue;
+        if (!WritePage(offset, std::min(PageSize(), fileSize - offset))) return false;
+    }
+    dirtyPages.clear();
+    if (!FlushFileBuffers(hFile)) {
+        std::cerr << "Failed to flush file with error: " << GetLastError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline void MappedFile::Close() {
+    if (view) UnmapViewOfFile(view);
+    if (hMapFile) CloseHandle(hMapFile);
+    if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+    view = nullptr;
+    hMapFile = NULL;
+    hFile = INVALID_HANDLE_VALUE;
+    fileSize = 0;
+    dirtyPages.clear();
+}
+
+#else
+
+inline size_t MappedFile::PageSize() {
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return pageSize;
+}
+
+// Allocates blocks for the new size so that running out of disk space fails
+// here rather than as SIGBUS on a later store through the mapping. File
+// systems without fallocate support fall back to a sparse ftruncate.
+inline bool MappedFile::SetFileSize(size_t size) {
+    if (size > fileSize) {
+        int result = posix_fallocate(fd, static_cast<off_t>(fileSize), static_cast<off_t>(size - fileSize));
+        if (result == 0) return true;
+        if (result != EINVAL && result != EOPNOTSUPP) {
+            std::cerr << "Failed to allocate file space: " << std::strerror(result) << std::endl;
+            return false;
+        }
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        std::cerr << "Failed to set file size: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool MappedFile::Open(const char *filename, size_t size, unsigned flags) {
+    Close();
+    copyOnWrite = (flags & CopyOnWrite) != 0;
+    fd = open(filename, O_RDWR | O_CREAT | ((flags & Truncate) ? O_TRUNC : 0), 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to create file: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    off_t existing = lseek(fd, 0, SEEK_END);
+    if (existing > 0) {
+        fileSize = static_cast<size_t>(existing);
+        size = std::max(size, fileSize);
+    }
+    if (size > RESERVED_BYTES) {
+        std::cerr << "File size exceeds the reserved address space" << std::endl;
+        Close();
+        return false;
+    }
+
+    void *reserved = mmap(nullptr, RESERVED_BYTES, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED) {
+        std::cerr << "Failed to reserve address space: " << std::strerror(errno) << std::endl;
+        Close();
+        return false;
+    }
+    view = reserved;
+
+    // Map what the file already holds, then grow it to the requested size.
+    if (fileSize > 0 && !MapPages(0, PageAlign(fileSize))) {
+        Close();
+        return false;
+    }
+    mappedBytes = PageAlign(fileSize);
+    if (!Resize(size)) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+inline bool MappedFile::MapPages(size_t offset, size_t length) {
+    int sharing = copyOnWrite ? MAP_PRIVATE : MAP_SHARED;
+    if (mmap(static_cast<char *>(view) + offset, length, PROT_READ | PROT_WRITE, sharing | MAP_FIXED,
+             fd, static_cast<off_t>(offset)) == MAP_FAILED) {
+        std::cerr << "Failed to map file pages: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool MappedFile::Resize(size_t newSize) {
+    if (newSize > RESERVED_BYTES) {
+        std::cerr << "File size exceeds the reserved address space" << std::endl;
+        return false;
+    }
+    char *base = static_cast<char *>(view);
+    size_t newMapped = PageAlign(newSize);
+
+    if (newSize > fileSize) {
+        if (!SetFileSize(newSize)) return false;
+        if (newMapped > mappedBytes && !MapPages(mappedBytes, newMapped - mappedBytes)) return false;
+    } else {
+        // Return the tail pages to the reservation before cutting the file,
+        // so no live mapping ever extends past the end of the file.
+        if (newMapped < mappedBytes &&
+            mmap(base + newMapped, mappedBytes - newMapped, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+                 -1, 0) == MAP_FAILED) {
+            std::cerr << "Failed to unmap file pages: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (!SetFileSize(newSize)) return false;
+    }
+
+    mappedBytes = newMapped;
+    fileSize = newSize;
+    return true;
+}
+
+inline void MappedFile::Advise(size_t offset, size_t length, AccessHint hint) {
+    if (offset >= fileSize) return;
+    // madvise wants a page-aligned start.
+    size_t start = offset / PageSize() * PageSize();
+    size_t end = std::min(offset + length, fileSize);
+    int advice = hint == Sequential ? MADV_SEQUENTIAL : hint == WillNeed ? MADV_WILLNEED : MADV_NORMAL;
+    madvise(static_cast<char *>(view) + start, end - start, advice);
+}
+
+inline bool MappedFile::WritePage(size_t offset, size_t length) {
+    const char *source = static_cast<const char *>(view) + offset;
+    while (length > 0) {
+        ssize_t written = pwrite(fd, source, length, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) {
+            std::cerr << "Failed to write page: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        source += written;
+        offset += static_cast<size_t>(written);
+        length -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+inline bool MappedFile::Flush() {
+    if (!copyOnWrite && mappedBytes > 0 && msync(view, mappedBytes, MS_SYNC) != 0) {
+        std::cerr << "Failed to flush mapping: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    for (size_t page = 0; page < dirtyPages.size(); ++page) {
+        size_t offset = page * PageSize();
+        if (!dirtyPages[page] || offset >= fileSize) continue;
+        if (!WritePage(offset, std::min(PageSize(), fileSize - offset))) return false;
+    }
+    dirtyPages.clear();
+    if (fdatasync(fd) != 0) {
+        std::cerr << "Failed to sync file: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline void MappedFile::Close() {
+    if (view) munmap(view, RESERVED_BYTES);
+    if (fd >= 0) close(fd);
+    view = nullptr;
+    fd = -1;
+    fileSize = 0;
+    mappedBytes = 0;
+    dirtyPages.clear();
+}
+
+#endif
+
+#endif //DATABASE_MAPPED_FILE_H
@@ -0,0 +1,134 @@
+#ifndef DATABASE_NAME_HEAP_H
+#define DATABASE_NAME_HEAP_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include "mapped_file.h"
+
+// Append-only string heap in its own mapped file. Records refer to a name by
+// the offset of its first character. Each name is stored as a 16-bit length,
+// its characters and a terminating NUL, so Get returns a C string without
+// copying. Offset EMPTY_NAME always holds "".
+//
+// With dictionary encoding a name already in the heap is returned instead of
+// being stored again. The dictionary lives in memory and is rebuilt from the
+// heap on open.
+class NameHeap {
+public:
+    static const uint32_t EMPTY_NAME = 16 + sizeof(uint16_t);
+    static const size_t MAX_NAME = UINT16_MAX;
+
+    bool Open(const char *filename, unsigned flags, bool useDictionary);
+    bool Flush() { return file.Flush(); }
+    void Close() {
+        file.Close();
+        dictionary.clear();
+    }
+
+    // Stores name, cut to MAX_NAME bytes, and returns its reference; 0 if
+    // the heap could not grow.
+    uint32_t Store(const char *name, size_t length);
+    uint32_t Store(const char *name) { return Store(name, strlen(name)); }
+
+    const char *Get(uint32_t ref) const { return static_cast<const char *>(file.data()) + ref; }
+    size_t used() const { return header()->used; }
+    bool dictionaryEncoded() const { return useDictionary; }
+
+    // Reference of name via the dictionary; 0 if it is not in the heap or
+    // the heap is not dictionary-encoded.
+    uint32_t Find(const char *name, size_t length) const;
+    // Calls visit(ref, name, length) for every stored name, "" included, in
+    // heap order.
+    template <typename Visit>
+    void ForEach(Visit visit) const;
+
+private:
+    static const uint32_t MAGIC = 0x50414548; // "HEAP"
+
+    struct Header {
+        uint32_t magic;
+        uint32_t reserved;
+        uint64_t used;
+    };
+    static_assert(sizeof(Header) + sizeof(uint16_t) == EMPTY_NAME, "EMPTY_NAME must follow the header");
+
+    MappedFile file;
+    bool useDictionary = true;
+    std::unordered_map<std::string, uint32_t> dictionary;
+
+    Header *header() const { return static_cast<Header *>(file.data()); }
+    char *bytes() const { return static_cast<char *>(file.data()); }
+    uint32_t Append(const char *name, size_t length);
+};
+
+inline bool NameHeap::Open(const char *filename, unsigned flags, bool useDictionary) {
+    this->useDictionary = useDictionary;
+    dictionary.clear();
+    if (!file.Open(filename, 4096, flags)) return false;
+
+    if (header()->magic != MAGIC || header()->used < EMPTY_NAME + 1 || header()->used > file.size()) {
+        *header() = {MAGIC, 0, sizeof(Header)};
+        file.MarkDirty(0, sizeof(Header));
+        Append("", 0);
+    }
+
+    if (useDictionary) {
+        ForEach([&](uint32_t ref, const char *name, size_t length) { dictionary.emplace(std::string(name, length), ref); });
+    }
+    return true;
+}
+
+inline uint32_t NameHeap::Find(const char *name, size_t length) const {
+    if (length == 0) return EMPTY_NAME;
+    auto found = dictionary.find(std::string(name, std::min(length, MAX_NAME)));
+    return found == dictionary.end() ? 0 : found->second;
+}
+
+template <typename Visit>
+void NameHeap::ForEach(Visit visit) const {
+    for (size_t offset = sizeof(Header); offset < header()->used;) {
+        uint16_t length;
+        memcpy(&length, bytes() + offset, sizeof(length));
+        uint32_t ref = static_cast<uint32_t>(offset + sizeof(length));
+        visit(ref, bytes() + ref, static_cast<size_t>(length));
+        offset = ref + length + 1;
+    }
+}
+
+inline uint32_t NameHeap::Append(const char *name, size_t length) {
+    size_t offset = header()->used;
+    size_t needed = offset + sizeof(uint16_t) + length + 1;
+    if (needed > UINT32_MAX) return 0;
+    if (needed > file.size()) {
+        size_t newSize = file.size();
+        while (newSize < needed) newSize *= 2;
+        if (!file.Resize(newSize)) return 0;
+    }
+
+    uint16_t storedLength = static_cast<uint16_t>(length);
+    memcpy(bytes() + offset, &storedLength, sizeof(storedLength));
+    memcpy(bytes() + offset + sizeof(storedLength), name, length);
+    bytes()[needed - 1] = '\0';
+    header()->used = needed;
+    file.MarkDirty(offset, needed - offset);
+    file.MarkDirty(0, sizeof(Header));
+    return static_cast<uint32_t>(offset + sizeof(storedLength));
+}
+
+inline uint32_t NameHeap::Store(const char *name, size_t length) {
+    if (length > MAX_NAME) length = MAX_NAME;
+    if (length == 0) return EMPTY_NAME;
+    if (!useDictionary) return Append(name, length);
+
+    std::string key(name, length);
+    auto found = dictionary.find(key);
+    if (found != dictionary.end()) return found->second;
+    uint32_t ref = Append(name, length);
+    if (ref != 0) dictionary.emplace(std::move(key), ref);
+    return ref;
+}
+
+#endif //DATABASE_NAME_HEAP_H
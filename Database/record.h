@@ -0,0 +1,15 @@
+#ifndef DATABASE_RECORD_H
+#define DATABASE_RECORD_H
+
+#include <cstdint>
+
+// Fixed-size slot: the name lives in the name heap, so a record takes
+// 8 bytes instead of the 56 of the inline char name[50] layout.
+struct Record {
+    int32_t id;
+    uint32_t name;
+};
+
+static_assert(sizeof(Record) == 8, "records are scanned as packed 8-byte slots");
+
+#endif //DATABASE_RECORD_H
@@ -0,0 +1,162 @@
+#ifndef DATABASE_RECORD_INDEX_H
+#define DATABASE_RECORD_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "mapped_file.h"
+
+// Persistent hash index from record id to slot, stored in its own mapped
+// file: a small header followed by a power-of-two table of (id, slot)
+// entries with linear probing. Erase shifts the following entries of the
+// probe run back instead of leaving tombstones, so lookups never slow down
+// after many deletes. The table doubles above half full and halves below
+// one eighth full.
+class RecordIndex {
+public:
+    static const int NOT_FOUND = -1;
+
+    // Creates or truncates filename with room for at least capacity ids.
+    bool Open(const char *filename, size_t capacity);
+    // Opens an index written earlier; false if it is missing or damaged.
+    bool Reopen(const char *filename);
+    bool Flush() { return file.Flush(); }
+    void Close() { file.Close(); }
+
+    // Slot of id, or NOT_FOUND.
+    int Get(int id) const;
+    // Inserts id or moves it to slot; false if the table has to grow and
+    // the file cannot.
+    bool Put(int id, int slot);
+    // Grows the table so that more new ids fit without growing it in Put.
+    bool Reserve(size_t more);
+    bool Erase(int id);
+
+    size_t size() const { return header()->count; }
+
+private:
+    static const uint32_t MAGIC = 0x58444952; // "RIDX"
+    static const size_t MIN_CAPACITY = 16;
+    static const int32_t EMPTY = -1;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t reserved;
+        uint64_t capacity;
+        uint64_t count;
+    };
+
+    struct Entry {
+        int32_t id;
+        int32_t slot;
+    };
+
+    MappedFile file;
+
+    Header *header() const { return static_cast<Header *>(file.data()); }
+    Entry *entries() const { return reinterpret_cast<Entry *>(header() + 1); }
+
+    size_t Home(int id) const {
+        // Fibonacci hashing spreads sequential ids across the table.
+        uint64_t hash = static_cast<uint32_t>(id) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(hash >> 32) & (header()->capacity - 1);
+    }
+
+    static size_t FileSize(size_t capacity) { return sizeof(Header) + capacity * sizeof(Entry); }
+
+    bool Rehash(size_t capacity);
+    void Insert(int id, int slot);
+};
+
+inline bool RecordIndex::Open(const char *filename, size_t capacity) {
+    size_t tableSize = MIN_CAPACITY;
+    while (tableSize < capacity * 2) tableSize *= 2;
+    if (!file.Open(filename, FileSize(tableSize))) return false;
+
+    *header() = {MAGIC, 0, tableSize, 0};
+    for (size_t i = 0; i < tableSize; ++i) entries()[i] = {0, EMPTY};
+    return true;
+}
+
+inline bool RecordIndex::Reopen(const char *filename) {
+    if (!file.Open(filename, 0, 0)) return false;
+    const Header *existing = header();
+    bool valid = file.size() >= sizeof(Header) && existing->magic == MAGIC && existing->capacity >= MIN_CAPACITY &&
+                 (existing->capacity & (existing->capacity - 1)) == 0 && file.size() >= FileSize(existing->capacity) &&
+                 existing->count * 2 <= existing->capacity;
+    if (!valid) file.Close();
+    return valid;
+}
+
+inline int RecordIndex::Get(int id) const {
+    const Entry *table = entries();
+    size_t mask = header()->capacity - 1;
+    for (size_t i = Home(id);; i = (i + 1) & mask) {
+        if (table[i].slot == EMPTY) return NOT_FOUND;
+        if (table[i].id == id) return table[i].slot;
+    }
+}
+
+inline void RecordIndex::Insert(int id, int slot) {
+    Entry *table = entries();
+    size_t mask = header()->capacity - 1;
+    size_t i = Home(id);
+    while (table[i].slot != EMPTY && table[i].id != id) i = (i + 1) & mask;
+    if (table[i].slot == EMPTY) header()->count++;
+    table[i] = {id, slot};
+}
+
+inline bool RecordIndex::Put(int id, int slot) {
+    if ((header()->count + 1) * 2 > header()->capacity && !Rehash(header()->capacity * 2)) return false;
+    Insert(id, slot);
+    return true;
+}
+
+inline bool RecordIndex::Reserve(size_t more) {
+    size_t capacity = header()->capacity;
+    while ((header()->count + more) * 2 > capacity) capacity *= 2;
+    return capacity == header()->capacity || Rehash(capacity);
+}
+
+inline bool RecordIndex::Erase(int id) {
+    Entry *table = entries();
+    size_t mask = header()->capacity - 1;
+    size_t hole = Home(id);
+    while (table[hole].slot != EMPTY && table[hole].id != id) hole = (hole + 1) & mask;
+    if (table[hole].slot == EMPTY) return false;
+
+    // Backward-shift deletion: move up any later entry of the run whose home
+    // position does not lie cyclically between the hole and itself.
+    for (size_t next = (hole + 1) & mask; table[next].slot != EMPTY; next = (next + 1) & mask) {
+        size_t home = Home(table[next].id);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            table[hole] = table[next];
+            hole = next;
+        }
+    }
+    table[hole].slot = EMPTY;
+    header()->count--;
+
+    if (header()->capacity > MIN_CAPACITY && header()->count * 8 < header()->capacity) {
+        Rehash(header()->capacity / 2);
+    }
+    return true;
+}
+
+inline bool RecordIndex::Rehash(size_t capacity) {
+    std::vector<std::pair<int, int>> live;
+    live.reserve(header()->count);
+    for (size_t i = 0; i < header()->capacity; ++i) {
+        if (entries()[i].slot != EMPTY) live.emplace_back(entries()[i].id, entries()[i].slot);
+    }
+
+    if (!file.Resize(FileSize(capacity))) return false;
+    header()->capacity = capacity;
+    header()->count = 0;
+    for (size_t i = 0; i < capacity; ++i) entries()[i] = {0, EMPTY};
+    for (const auto &entry : live) Insert(entry.first, entry.second);
+    return true;
+}
+
+#endif //DATABASE_RECORD_INDEX_H
@@ -0,0 +1,268 @@
+#ifndef DATABASE_RECORD_SCAN_H
+#define DATABASE_RECORD_SCAN_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+#include "name_heap.h"
+#include "record.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RECORD_SCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SCAN_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SCAN_TARGET(isa)
+#endif
+
+// Predicate for ScanRecords: a record matches when its id lies in
+// [minId, maxId] and its name passes nameMatch.
+struct ScanQuery {
+    enum NameMatch {
+        AnyName,
+        NameEquals,
+        NamePrefix
+    };
+
+    int32_t minId = std::numeric_limits<int32_t>::min();
+    int32_t maxId = std::numeric_limits<int32_t>::max();
+    NameMatch nameMatch = AnyName;
+    std::string name;
+    // Worker threads for a large scan; 0 uses every hardware thread.
+    unsigned threads = 0;
+};
+
+// Records are scanned in blocks of SCAN_BLOCK_RECORDS slots (32 KiB, about an
+// L1 cache), and a scan is only split across threads once each thread gets
+// at least SCAN_MIN_RECORDS_PER_THREAD of them.
+const size_t SCAN_BLOCK_RECORDS = 4096;
+const size_t SCAN_MIN_RECORDS_PER_THREAD = size_t(1) << 18;
+
+// The name condition resolved against the heap before the scan, so the scan
+// itself never touches name strings. Names are compared by reference: with
+// dictionary encoding an equal name has exactly one, otherwise the heap is
+// walked once for the references that match.
+struct CompiledScan {
+    int32_t minId;
+    int32_t maxId;
+    // The name must be this one reference.
+    bool byRef = false;
+    uint32_t ref = 0;
+    // The name must be one of the references set in refBits.
+    bool byBitmap = false;
+    std::vector<uint64_t> refBits;
+    // No name in the heap passes, so nothing can match.
+    bool impossible = false;
+
+    bool HasRef(uint32_t name) const {
+        return (name >> 6) < refBits.size() && (refBits[name >> 6] >> (name & 63)) & 1;
+    }
+};
+
+inline CompiledScan CompileScan(const ScanQuery &query, const NameHeap &names) {
+    CompiledScan compiled;
+    compiled.minId = query.minId;
+    compiled.maxId = query.maxId;
+    compiled.impossible = query.minId > query.maxId;
+    if (query.nameMatch == ScanQuery::AnyName || (query.nameMatch == ScanQuery::NamePrefix && query.name.empty())) {
+        return compiled;
+    }
+
+    // Names are stored cut to MAX_NAME bytes.
+    std::string target = query.name.substr(0, NameHeap::MAX_NAME);
+    if (query.nameMatch == ScanQuery::NameEquals && names.dictionaryEncoded()) {
+        compiled.ref = names.Find(target.data(), target.size());
+        compiled.byRef = compiled.ref != 0;
+        compiled.impossible = compiled.impossible || !compiled.byRef;
+        return compiled;
+    }
+
+    bool prefix = query.nameMatch == ScanQuery::NamePrefix;
+    size_t matches = 0;
+    compiled.refBits.assign(names.used() / 64 + 1, 0);
+    names.ForEach([&](uint32_t ref, const char *name, size_t length) {
+        bool match = prefix ? length >= target.size() && memcmp(name, target.data(), target.size()) == 0
+                            : length == target.size() && memcmp(name, target.data(), length) == 0;
+        if (!match) return;
+        compiled.refBits[ref >> 6] |= uint64_t(1) << (ref & 63);
+        compiled.ref = ref;
+        ++matches;
+    });
+    compiled.byRef = matches == 1;
+    compiled.byBitmap = matches > 1;
+    compiled.impossible = compiled.impossible || matches == 0;
+    if (!compiled.byBitmap) compiled.refBits.clear();
+    return compiled;
+}
+
+inline unsigned LowestBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+inline unsigned BitCount(unsigned mask) {
+    unsigned count = 0;
+    for (; mask; mask &= mask - 1) ++count;
+    return count;
+}
+
+// Counts the candidates in mask (bit i is slot base + i) that pass the
+// bitmap, if any, and appends them to rows.
+inline size_t EmitMatches(unsigned mask, size_t base, const Record *records, const CompiledScan &scan,
+                          std::vector<uint32_t> *rows) {
+    if (!rows && !scan.byBitmap) return BitCount(mask);
+    size_t count = 0;
+    for (; mask; mask &= mask - 1) {
+        size_t slot = base + LowestBit(mask);
+        if (scan.byBitmap && !scan.HasRef(records[slot].name)) continue;
+        ++count;
+        if (rows) rows->push_back(static_cast<uint32_t>(slot));
+    }
+    return count;
+}
+
+inline size_t ScanBlockScalar(const Record *records, size_t begin, size_t end, const CompiledScan &scan,
+                              std::vector<uint32_t> *rows) {
+    size_t count = 0;
+    for (size_t slot = begin; slot < end; slot += 8) {
+        unsigned mask = 0;
+        size_t lanes = std::min<size_t>(8, end - slot);
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            const Record &record = records[slot + lane];
+            bool match = record.id >= scan.minId && record.id <= scan.maxId && (!scan.byRef || record.name == scan.ref);
+            mask |= unsigned(match) << lane;
+        }
+        if (mask) count += EmitMatches(mask, slot, records, scan, rows);
+    }
+    return count;
+}
+
+#ifdef RECORD_SCAN_X86
+
+// Four records per register, each a 64-bit lane with the id in its low half
+// and the name reference in its high half. The id test is moved to the high
+// half and combined with the name test, and the lane sign bits give the mask.
+template <bool ByRef>
+SCAN_TARGET("avx2") inline unsigned MatchMaskAvx2(__m256i lanes, __m256i minId, __m256i maxId, __m256i ref) {
+    __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(minId, lanes), _mm256_cmpgt_epi32(lanes, maxId));
+    __m256i match = _mm256_slli_epi64(_mm256_xor_si256(outside, _mm256_set1_epi32(-1)), 32);
+    if (ByRef) match = _mm256_and_si256(match, _mm256_cmpeq_epi32(lanes, ref));
+    return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(match)));
+}
+
+template <bool ByRef>
+SCAN_TARGET("avx2") inline size_t ScanBlockAvx2(const Record *records, size_t begin, size_t end,
+                                                const CompiledScan &scan, std::vector<uint32_t> *rows) {
+    const __m256i minId = _mm256_set1_epi32(scan.minId);
+    const __m256i maxId = _mm256_set1_epi32(scan.maxId);
+    const __m256i ref = _mm256_set1_epi32(static_cast<int>(scan.ref));
+    size_t count = 0;
+    size_t slot = begin;
+    for (; slot + 8 <= end; slot += 8) {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(records + slot));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(records + slot + 4));
+        unsigned mask = MatchMaskAvx2<ByRef>(low, minId, maxId, ref) |
+                        MatchMaskAvx2<ByRef>(high, minId, maxId, ref) << 4;
+        if (mask) count += EmitMatches(mask, slot, records, scan, rows);
+    }
+    return count + ScanBlockScalar(records, slot, end, scan, rows);
+}
+
+inline bool ScanHasAvx2() {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    // The OS must save YMM state (XCR0 bits 1-2).
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+#endif
+
+typedef size_t (*ScanBlockKernel)(const Record *, size_t, size_t, const CompiledScan &, std::vector<uint32_t> *);
+
+// Block kernel for this CPU and query, picked once from CPUID.
+inline ScanBlockKernel SelectScanKernel(const CompiledScan &scan) {
+#ifdef RECORD_SCAN_X86
+    static const bool avx2 = ScanHasAvx2();
+    if (avx2) return scan.byRef ? ScanBlockAvx2<true> : ScanBlockAvx2<false>;
+#endif
+    (void) scan;
+    return ScanBlockScalar;
+}
+
+inline const char *ScanKernelName() {
+    return SelectScanKernel(CompiledScan()) == ScanBlockScalar ? "scalar" : "avx2";
+}
+
+inline size_t ScanRange(const Record *records, size_t begin, size_t end, const CompiledScan &scan,
+                        std::vector<uint32_t> *rows) {
+    ScanBlockKernel kernel = SelectScanKernel(scan);
+    size_t count = 0;
+    for (size_t block = begin; block < end; block += SCAN_BLOCK_RECORDS) {
+        count += kernel(records, block, std::min(end, block + SCAN_BLOCK_RECORDS), scan, rows);
+    }
+    return count;
+}
+
+// Scans slots [0, count) and returns how many match query; with rows, also
+// appends the matching slots in ascending order. Large scans are split into
+// contiguous ranges, one per thread, and the rows joined in order.
+inline size_t ScanRecords(const Record *records, size_t count, const NameHeap &names, const ScanQuery &query,
+                          std::vector<uint32_t> *rows = nullptr) {
+    CompiledScan scan = CompileScan(query, names);
+    if (scan.impossible || count == 0) return 0;
+
+    size_t threads = query.threads ? query.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max<size_t>(1, std::min(threads, count / SCAN_MIN_RECORDS_PER_THREAD));
+    if (threads == 1) return ScanRange(records, 0, count, scan, rows);
+
+    size_t blocks = (count + SCAN_BLOCK_RECORDS - 1) / SCAN_BLOCK_RECORDS;
+    size_t chunk = (blocks + threads - 1) / threads * SCAN_BLOCK_RECORDS;
+    std::vector<size_t> counts(threads, 0);
+    std::vector<std::vector<uint32_t>> parts(rows ? threads : 0);
+    auto scanPart = [&](size_t part) {
+        size_t begin = std::min(count, part * chunk);
+        size_t end = std::min(count, begin + chunk);
+        counts[part] = ScanRange(records, begin, end, scan, rows ? &parts[part] : nullptr);
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t part = 1; part < threads; ++part) workers.emplace_back(scanPart, part);
+    scanPart(0);
+    for (auto &worker : workers) worker.join();
+
+    size_t total = 0;
+    for (size_t part = 0; part < threads; ++part) {
+        total += counts[part];
+        if (rows) rows->insert(rows->end(), parts[part].begin(), parts[part].end());
+    }
+    return total;
+}
+
+#endif //DATABASE_RECORD_SCAN_H
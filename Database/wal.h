@@ -0,0 +1,387 @@
+#ifndef DATABASE_WAL_H
+#define DATABASE_WAL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+inline uint32_t Crc32(const void *data, size_t length, uint32_t crc = 0) {
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> values(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) value = (value >> 1) ^ ((value & 1) ? 0xEDB88320u : 0);
+            values[i] = value;
+        }
+        return values;
+    }();
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// Append-only redo log. Every entry carries its log sequence number (LSN),
+// its length and a CRC32 of both plus the payload, so replay stops cleanly at
+// a torn tail.
+//
+// Append only buffers an entry. A background thread writes the buffer and
+// syncs it once per batch. It waits up to groupCommitWindow after the first
+// entry of a batch so that concurrent writers share one sync. WaitDurable
+// blocks a writer until its entry is on disk.
+//
+// The header records the last checkpointed LSN, an opaque word of caller
+// state saved with it and whether the log was closed cleanly. A checkpoint
+// empties the log.
+class WriteAheadLog {
+public:
+    typedef std::function<bool(const void *payload, size_t size)> ReplayCallback;
+
+    explicit WriteAheadLog(std::chrono::microseconds groupCommitWindow = std::chrono::microseconds(500))
+            : groupCommitWindow(groupCommitWindow) {}
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+    ~WriteAheadLog() { Close(false); }
+
+    // Opens or creates the log and reads its header.
+    bool Open(const char *filename);
+    // Passes every intact entry after the last checkpoint to replay in order,
+    // cuts off a torn tail and starts the flusher.
+    bool Recover(const ReplayCallback &replay);
+
+    bool WasClean() const { return clean; }
+    uint64_t checkpointState() const { return header.state; }
+
+    // Buffers payload and returns its LSN, or 0 if the log has failed.
+    uint64_t Append(const void *payload, size_t size);
+    bool WaitDurable(uint64_t lsn);
+    uint64_t lastLsn();
+    // Bytes of entries since the last checkpoint.
+    size_t size();
+
+    // Records that everything up to lastLsn() is in the data file and stores
+    // state with it. The caller must have flushed the data file and must not
+    // append concurrently.
+    bool Checkpoint(uint64_t state);
+    // Stops the flusher; markClean records an orderly shutdown.
+    void Close(bool markClean);
+
+private:
+    static const uint32_t MAGIC = 0x314C4157; // "WAL1"
+    static const size_t MAX_ENTRY_SIZE = size_t(1) << 20;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t clean;
+        uint64_t checkpointLsn;
+        uint64_t state;
+        uint32_t reserved;
+        uint32_t crc;
+    };
+
+    struct EntryHeader {
+        uint64_t lsn;
+        uint32_t size;
+        uint32_t crc;
+    };
+
+    std::chrono::microseconds groupCommitWindow;
+    Header header{};
+    bool clean = true;
+    size_t tail = 0;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable durable;
+    std::vector<char> pending;
+    uint64_t appendedLsn = 0;
+    uint64_t durableLsn = 0;
+    bool stopping = false;
+    bool failed = false;
+    std::thread flusher;
+
+#ifdef _WIN32
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+
+    bool OpenFile(const char *filename);
+    bool IsOpen() const;
+    bool ReadAt(size_t offset, void *data, size_t size);
+    bool WriteAt(size_t offset, const void *data, size_t size);
+    bool Sync();
+    bool Truncate(size_t size);
+    void CloseFile();
+
+    bool WriteHeader();
+    void FlushLoop();
+};
+
+#ifdef _WIN32
+
+inline bool WriteAheadLog::IsOpen() const { return hFile != INVALID_HANDLE_VALUE; }
+
+inline bool WriteAheadLog::ReadAt(size_t offset, void *data, size_t size) {
+    OVERLAPPED position{};
+    position.Offset = static_cast<DWORD>(offset);
+    position.OffsetHigh = static_cast<DWORD>(static_cast<unsigned long long>(offset) >> 32);
+    DWORD read = 0;
+    return ReadFile(hFile, data, static_cast<DWORD>(size), &read, &position) && read == size;
+}
+
+inline bool WriteAheadLog::WriteAt(size_t offset, const void *data, size_t size) {
+    OVERLAPPED position{};
+    position.Offset = static_cast<DWORD>(offset);
+    position.OffsetHigh = static_cast<DWORD>(static_cast<unsigned long long>(offset) >> 32);
+    DWORD written = 0;
+    if (!WriteFile(hFile, data, static_cast<DWORD>(size), &written, &position) || written != size) {
+        std::cerr << "Failed to write log with error: " << GetLastError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool WriteAheadLog::Sync() {
+    if (!FlushFileBuffers(hFile)) {
+        std::cerr << "Failed to flush log with error: " << GetLastError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool WriteAheadLog::Truncate(size_t size) {
+    LARGE_INTEGER distance;
+    distance.QuadPart = static_cast<LONGLONG>(size);
+    return SetFilePointerEx(hFile, distance, NULL, FILE_BEGIN) && SetEndOfFile(hFile);
+}
+
+inline void WriteAheadLog::CloseFile() {
+    if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+    hFile = INVALID_HANDLE_VALUE;
+}
+
+inline bool WriteAheadLog::OpenFile(const char *filename) {
+    hFile = CreateFile(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to open log with error: " << GetLastError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#else
+
+inline bool WriteAheadLog::IsOpen() const { return fd >= 0; }
+
+inline bool WriteAheadLog::ReadAt(size_t offset, void *data, size_t size) {
+    char *target = static_cast<char *>(data);
+    while (size > 0) {
+        ssize_t result = pread(fd, target, size, static_cast<off_t>(offset));
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0) return false;
+        target += result;
+        offset += static_cast<size_t>(result);
+        size -= static_cast<size_t>(result);
+    }
+    return true;
+}
+
+inline bool WriteAheadLog::WriteAt(size_t offset, const void *data, size_t size) {
+    const char *source = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t result = pwrite(fd, source, size, static_cast<off_t>(offset));
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0) {
+            std::cerr << "Failed to write log: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        source += result;
+        offset += static_cast<size_t>(result);
+        size -= static_cast<size_t>(result);
+    }
+    return true;
+}
+
+inline bool WriteAheadLog::Sync() {
+    if (fdatasync(fd) != 0) {
+        std::cerr << "Failed to sync log: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool WriteAheadLog::Truncate(size_t size) {
+    return ftruncate(fd, static_cast<off_t>(size)) == 0;
+}
+
+inline void WriteAheadLog::CloseFile() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+}
+
+inline bool WriteAheadLog::OpenFile(const char *filename) {
+    fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open log: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif
+
+inline bool WriteAheadLog::Open(const char *filename) {
+    if (!OpenFile(filename)) return false;
+    // A missing or damaged header starts an empty log.
+    Header existing{};
+    if (ReadAt(0, &existing, sizeof(existing)) && existing.magic == MAGIC &&
+        existing.crc == Crc32(&existing, offsetof(Header, crc))) {
+        header = existing;
+        clean = existing.clean != 0;
+    } else {
+        header = {MAGIC, 1, 0, 0, 0, 0};
+        clean = true;
+        if (!Truncate(0) || !WriteHeader()) {
+            CloseFile();
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool WriteAheadLog::WriteHeader() {
+    header.crc = Crc32(&header, offsetof(Header, crc));
+    return WriteAt(0, &header, sizeof(header)) && Sync();
+}
+
+inline bool WriteAheadLog::Recover(const ReplayCallback &replay) {
+    size_t offset = sizeof(Header);
+    uint64_t lsn = header.checkpointLsn;
+    std::vector<char> payload;
+
+    EntryHeader entry;
+    while (ReadAt(offset, &entry, sizeof(entry)) && entry.lsn == lsn + 1 && entry.size <= MAX_ENTRY_SIZE) {
+        payload.resize(entry.size);
+        if (!ReadAt(offset + sizeof(entry), payload.data(), entry.size)) break;
+        uint32_t crc = Crc32(&entry, offsetof(EntryHeader, crc));
+        if (Crc32(payload.data(), payload.size(), crc) != entry.crc) break;
+        if (!replay(payload.data(), payload.size())) return false;
+        lsn = entry.lsn;
+        offset += sizeof(entry) + entry.size;
+    }
+
+    // Anything after the last intact entry is a write that never completed.
+    header.clean = 0;
+    if (!Truncate(offset) || !WriteHeader()) return false;
+
+    tail = offset;
+    appendedLsn = durableLsn = lsn;
+    flusher = std::thread(&WriteAheadLog::FlushLoop, this);
+    return true;
+}
+
+inline uint64_t WriteAheadLog::Append(const void *payload, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (failed || stopping || size > MAX_ENTRY_SIZE) return 0;
+
+    EntryHeader entry{++appendedLsn, static_cast<uint32_t>(size), 0};
+    entry.crc = Crc32(payload, size, Crc32(&entry, offsetof(EntryHeader, crc)));
+    const char *bytes = reinterpret_cast<const char *>(&entry);
+    pending.insert(pending.end(), bytes, bytes + sizeof(entry));
+    pending.insert(pending.end(), static_cast<const char *>(payload), static_cast<const char *>(payload) + size);
+    if (pending.size() == sizeof(entry) + size) wake.notify_one();
+    return entry.lsn;
+}
+
+inline bool WriteAheadLog::WaitDurable(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mutex);
+    durable.wait(lock, [&] { return durableLsn >= lsn || failed; });
+    return durableLsn >= lsn;
+}
+
+inline uint64_t WriteAheadLog::lastLsn() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return appendedLsn;
+}
+
+inline size_t WriteAheadLog::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tail + pending.size() - sizeof(Header);
+}
+
+inline void WriteAheadLog::FlushLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return stopping || !pending.empty(); });
+        if (pending.empty()) break;
+        // Give other writers the window to join this batch.
+        if (!stopping && groupCommitWindow.count() > 0) {
+            wake.wait_for(lock, groupCommitWindow, [&] { return stopping; });
+        }
+
+        std::vector<char> batch;
+        batch.swap(pending);
+        uint64_t batchLsn = appendedLsn;
+        size_t offset = tail;
+        tail += batch.size();
+
+        lock.unlock();
+        bool ok = WriteAt(offset, batch.data(), batch.size()) && Sync();
+        lock.lock();
+
+        if (ok) durableLsn = batchLsn;
+        else failed = true;
+        durable.notify_all();
+    }
+}
+
+inline bool WriteAheadLog::Checkpoint(uint64_t state) {
+    uint64_t lsn = lastLsn();
+    if (!WaitDurable(lsn)) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    header.checkpointLsn = lsn;
+    header.state = state;
+    // Once the header names the new checkpoint the old entries are dead, so
+    // a crash before the truncate only leaves entries that replay skips.
+    if (!WriteHeader() || !Truncate(sizeof(Header))) {
+        failed = true;
+        return false;
+    }
+    tail = sizeof(Header);
+    return true;
+}
+
+inline void WriteAheadLog::Close(bool markClean) {
+    if (!IsOpen()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (flusher.joinable()) flusher.join();
+
+    if (markClean && !failed) {
+        header.clean = 1;
+        WriteHeader();
+    }
+    CloseFile();
+}
+
+#endif //DATABASE_WAL_H
@@ -0,0 +1,366 @@
+#ifndef LAB3_BROADCAST_RING_H
+#define LAB3_BROADCAST_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "wakeup.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+// What the writer does when the ring is full because a reader has not yet
+// read the oldest message.
+enum class OverflowPolicy : uint32_t {
+    Block,         // wait for the slowest reader
+    DropOldest,    // overwrite; the reader notices and skips ahead
+    DetachLaggard  // detach every reader still behind, then overwrite
+};
+
+// Single-producer/multi-consumer broadcast ring: every attached reader sees
+// every message, each at its own pace, in shared memory so that readers can
+// be separate processes.
+//
+// The layout follows SpscRing: a header, then capacity bytes of messages
+// that never wrap (a WRAP marker sends everyone back to offset 0). head is
+// the end of the published messages and tail the start of the oldest one
+// still kept. Each message carries its sequence number, so a reader knows
+// how many it has missed.
+//
+// The header holds MAX_READERS slots. A reader attaches by claiming a free
+// slot and publishes its cursor there after every read; the writer only
+// looks at the cursors when it runs out of room, to find the slowest reader
+// and decide, per OverflowPolicy, how far tail may move. Attaching and
+// detaching never stop the writer.
+//
+// Readers copy a message out and then check, seqlock-style, that tail has
+// not moved past it meanwhile; if it has, the copy may be torn and is thrown
+// away. Under Block this only happens to a reader that is still attaching.
+//
+// A slot also records the reader's process id. A reader that dies without
+// detaching would otherwise hold its slot, and under Block the writer,
+// forever: when the ring is full the writer frees the slots of readers whose
+// process is gone, whether still active or already detached.
+class BroadcastRing {
+public:
+    static const unsigned MAX_READERS = 16;
+
+    enum class ReadResult {
+        Message,  // message holds the next message
+        Empty,    // caught up with the writer
+        Detached  // the writer detached this reader
+    };
+
+    static size_t SegmentSize(size_t capacity) { return sizeof(Header) + capacity; }
+
+    BroadcastRing() = default;
+    BroadcastRing(const BroadcastRing &) = delete;
+    BroadcastRing &operator=(const BroadcastRing &) = delete;
+    ~BroadcastRing() { Detach(); }
+
+    // Writer side: formats memory of SegmentSize(capacity) bytes as an empty
+    // ring with no readers. capacity must be a power of two.
+    bool Init(void *memory, size_t capacity, OverflowPolicy policy);
+    // Publishes a message to every reader; false if it has to wait for room
+    // (Block policy only) or is longer than maxMessage().
+    bool TryWrite(const void *data, size_t length);
+
+
+    // Reader side: claims a reader slot; the reader receives the messages
+    // published from now on. False if the segment is not a broadcast ring or
+    // all slots are taken by running readers.
+    bool Attach(void *memory, size_t size);
+    // Gives the slot back. Safe to call more than once.
+    void Detach();
+    ReadResult TryRead(std::string &message);
+    // Messages this reader missed because the writer overwrote them.
+    uint64_t lost() const { return lostCount; }
+
+    size_t maxMessage() const { return capacity / 2 - MESSAGE_HEADER; }
+    OverflowPolicy policy() const { return static_cast<OverflowPolicy>(header->policy); }
+    // Attached readers whose process is still running.
+    unsigned readerCount() const;
+
+    // readable is notified by the writer after every message, writable by
+    // readers after every read, for a writer blocked under Block.
+    WakeupWord *readable() const { return &header->readable; }
+    WakeupWord *writable() const { return &header->writable; }
+
+private:
+    static const uint32_t MAGIC = 0x54534342; // "BCST"
+    static const uint32_t WRAP = UINT32_MAX;
+    static const size_t ALIGNMENT = 8;
+    // 32-bit length, then the low 32 bits of the sequence number.
+    static const size_t MESSAGE_HEADER = 2 * sizeof(uint32_t);
+
+    enum SlotState : uint32_t { FREE, ATTACHING, ACTIVE, DETACHED };
+
+    struct ReaderSlot {
+        alignas(64) std::atomic<uint32_t> state;
+        // Process id of the reader; 0 while the slot is free.
+        std::atomic<uint32_t> owner;
+        std::atomic<uint64_t> cursor;
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint32_t policy;
+        uint64_t capacity;
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+        alignas(64) WakeupWord readable;
+        alignas(64) WakeupWord writable;
+        ReaderSlot readers[MAX_READERS];
+        alignas(64) char data[1];
+    };
+
+    Header *header = nullptr;
+    uint64_t capacity = 0;
+
+    // Writer state.
+    uint32_t sequence = 0;
+
+    // Reader state.
+    ReaderSlot *slot = nullptr;
+    uint64_t cursor = 0;
+    uint32_t expected = 0;
+    bool started = false;
+    uint64_t lostCount = 0;
+
+    static uint64_t Align(uint64_t size) { return (size + ALIGNMENT - 1) & ~uint64_t(ALIGNMENT - 1); }
+    char *At(uint64_t position) const { return header->data + (position & (capacity - 1)); }
+    uint64_t UntilEnd(uint64_t position) const { return capacity - (position & (capacity - 1)); }
+
+    // Start of the message after the one at position; writer side only.
+    uint64_t NextMessage(uint64_t position) const;
+    // Lowest cursor among attached readers, or head if there are none.
+    uint64_t SlowestCursor(uint64_t head) const;
+    // Moves tail to at least target, as far as the policy allows.
+    bool Reclaim(uint64_t target, uint64_t head);
+    // Frees the slots of readers whose process has exited. The writer calls
+    // it whenever the ring is full, a reader when it finds no free slot.
+    void ReapDeadReaders();
+    // Takes over reader, already moved to ATTACHING, for this reader.
+    void Claim(ReaderSlot &reader);
+
+    static uint32_t CurrentProcess();
+    static bool ProcessAlive(uint32_t pid);
+};
+
+inline uint32_t BroadcastRing::CurrentProcess() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint32_t>(getpid());
+#endif
+}
+
+inline bool BroadcastRing::ProcessAlive(uint32_t pid) {
+#ifdef _WIN32
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (!process) return GetLastError() == ERROR_ACCESS_DENIED;
+    bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return alive;
+#else
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+#endif
+}
+
+inline bool BroadcastRing::Init(void *memory, size_t capacity, OverflowPolicy policy) {
+    if (capacity < 64 || (capacity & (capacity - 1)) != 0) return false;
+    header = static_cast<Header *>(memory);
+    header->policy = static_cast<uint32_t>(policy);
+    header->capacity = capacity;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    for (WakeupWord *word : {&header->readable, &header->writable}) {
+        word->sequence.store(0, std::memory_order_relaxed);
+        word->waiters.store(0, std::memory_order_relaxed);
+    }
+    for (ReaderSlot &reader : header->readers) {
+        reader.state.store(FREE, std::memory_order_relaxed);
+        reader.owner.store(0, std::memory_order_relaxed);
+        reader.cursor.store(0, std::memory_order_relaxed);
+    }
+    header->magic = MAGIC;
+    this->capacity = capacity;
+    sequence = 0;
+    return true;
+}
+
+inline uint64_t BroadcastRing::NextMessage(uint64_t position) const {
+    uint32_t length;
+    memcpy(&length, At(position), sizeof(length));
+    if (length == WRAP) {
+        position += UntilEnd(position);
+        memcpy(&length, At(position), sizeof(length));
+    }
+    return position + Align(MESSAGE_HEADER + length);
+}
+
+inline uint64_t BroadcastRing::SlowestCursor(uint64_t head) const {
+    uint64_t slowest = head;
+    for (const ReaderSlot &reader : header->readers) {
+        if (reader.state.load(std::memory_order_acquire) != ACTIVE) continue;
+        slowest = std::min(slowest, reader.cursor.load(std::memory_order_acquire));
+    }
+    return slowest;
+}
+
+inline void BroadcastRing::ReapDeadReaders() {
+    for (ReaderSlot &reader : header->readers) {
+        uint32_t state = reader.state.load(std::memory_order_acquire);
+        if (state == FREE) continue;
+        uint32_t owner = reader.owner.load(std::memory_order_relaxed);
+        if (owner == 0 || ProcessAlive(owner)) continue;
+        // Writer and attaching readers may reap at once; clearing owner
+        // first picks one of them.
+        if (!reader.owner.compare_exchange_strong(owner, 0, std::memory_order_relaxed)) continue;
+        reader.state.store(FREE, std::memory_order_release);
+    }
+}
+
+inline bool BroadcastRing::Reclaim(uint64_t target, uint64_t head) {
+    ReapDeadReaders();
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    // A reader still behind tail will skip ahead on its next read.
+    uint64_t slowest = std::max(SlowestCursor(head), tail);
+    auto policy = this->policy();
+
+    uint64_t newTail = tail;
+    while (newTail < target) {
+        if (newTail >= slowest && policy == OverflowPolicy::Block) break;
+        newTail = NextMessage(newTail);
+    }
+
+    if (newTail > slowest && policy == OverflowPolicy::DetachLaggard) {
+        for (ReaderSlot &reader : header->readers) {
+            uint32_t active = ACTIVE;
+            if (reader.cursor.load(std::memory_order_acquire) < newTail) {
+                reader.state.compare_exchange_strong(active, DETACHED, std::memory_order_acq_rel);
+            }
+        }
+    }
+
+    // Seqlock write side: move tail before the bytes behind it are reused,
+    // so a reader that sees the new bytes also sees the new tail.
+    header->tail.store(newTail, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return newTail >= target;
+}
+
+inline bool BroadcastRing::TryWrite(const void *data, size_t length) {
+    if (length > maxMessage()) return false;
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    uint64_t needed = Align(MESSAGE_HEADER + length);
+    uint64_t untilEnd = UntilEnd(head);
+    uint64_t total = needed <= untilEnd ? needed : untilEnd + needed;
+
+    if (head + total - header->tail.load(std::memory_order_relaxed) > capacity &&
+        !Reclaim(head + total - capacity, head)) {
+        return false;
+    }
+
+    if (needed > untilEnd) {
+        uint32_t wrap = WRAP;
+        memcpy(At(head), &wrap, sizeof(wrap));
+        head += untilEnd;
+    }
+    uint32_t fields[2] = {static_cast<uint32_t>(length), sequence++};
+    memcpy(At(head), fields, sizeof(fields));
+    memcpy(At(head) + MESSAGE_HEADER, data, length);
+    header->head.store(head + needed, std::memory_order_release);
+    return true;
+}
+
+inline bool BroadcastRing::Attach(void *memory, size_t size) {
+    auto *existing = static_cast<Header *>(memory);
+    if (size < sizeof(Header) || existing->magic != MAGIC || size < SegmentSize(existing->capacity)) return false;
+
+    header = existing;
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1) ReapDeadReaders();
+        for (ReaderSlot &reader : existing->readers) {
+            uint32_t free = FREE;
+            if (!reader.state.compare_exchange_strong(free, ATTACHING, std::memory_order_acquire)) continue;
+            Claim(reader);
+            return true;
+        }
+    }
+    header = nullptr;
+    return false;
+}
+
+inline void BroadcastRing::Claim(ReaderSlot &reader) {
+    capacity = header->capacity;
+    slot = &reader;
+    slot->owner.store(CurrentProcess(), std::memory_order_relaxed);
+    cursor = header->head.load(std::memory_order_acquire);
+    slot->cursor.store(cursor, std::memory_order_relaxed);
+    // If the writer reclaimed past cursor before seeing the slot, the
+    // first TryRead skips ahead to tail.
+    slot->state.store(ACTIVE, std::memory_order_seq_cst);
+    started = false;
+    lostCount = 0;
+}
+
+inline void BroadcastRing::Detach() {
+    if (!slot) return;
+    slot->owner.store(0, std::memory_order_relaxed);
+    slot->state.store(FREE, std::memory_order_release);
+    slot = nullptr;
+}
+
+inline unsigned BroadcastRing::readerCount() const {
+    unsigned count = 0;
+    for (const ReaderSlot &reader : header->readers) {
+        if (reader.state.load(std::memory_order_relaxed) != ACTIVE) continue;
+        uint32_t owner = reader.owner.load(std::memory_order_relaxed);
+        if (owner == 0 || ProcessAlive(owner)) ++count;
+    }
+    return count;
+}
+
+inline BroadcastRing::ReadResult BroadcastRing::TryRead(std::string &message) {
+    for (;;) {
+        if (!slot || slot->state.load(std::memory_order_acquire) != ACTIVE) return ReadResult::Detached;
+
+        uint64_t tail = header->tail.load(std::memory_order_acquire);
+        if (cursor < tail) cursor = tail;
+        if (cursor == header->head.load(std::memory_order_acquire)) return ReadResult::Empty;
+
+        uint64_t position = cursor;
+        uint32_t fields[2];
+        memcpy(fields, At(position), sizeof(fields));
+        if (fields[0] == WRAP) {
+            position += UntilEnd(position);
+            memcpy(fields, At(position), sizeof(fields));
+        }
+        // A torn length is caught by the tail check below; it only has to be
+        // kept from reading past the data area first.
+        bool fits = fields[0] <= maxMessage() && MESSAGE_HEADER + fields[0] <= UntilEnd(position);
+        if (fits) message.assign(At(position) + MESSAGE_HEADER, fields[0]);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->tail.load(std::memory_order_relaxed) > cursor) continue;
+        if (!fits) return ReadResult::Detached;
+
+        if (started && fields[1] != expected) lostCount += fields[1] - expected;
+        expected = fields[1] + 1;
+        started = true;
+        cursor = position + Align(MESSAGE_HEADER + fields[0]);
+        slot->cursor.store(cursor, std::memory_order_release);
+        return ReadResult::Message;
+    }
+}
+
+#endif //LAB3_BROADCAST_RING_H
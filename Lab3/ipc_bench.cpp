@@ -0,0 +1,583 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "broadcast_ring.h"
+#include "message_log.h"
+#include "shared_segment.h"
+#include "spsc_ring.h"
+#include "wakeup.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif
+
+// Benchmark for the Lab3 transports between two processes. The driver
+// starts a copy of itself as the peer (--peer) and measures:
+//   pingpong    round trips of one message, as a latency distribution;
+//   throughput  one-way messages per second and bytes per second;
+// for each transport, message size and pinning (none, both processes on the
+// same CPU, or on different CPUs). The forward channel is the transport under
+// test; replies always travel over an SpscRing, so differences between
+// transports come from the forward direction. Waiting uses Wakeup, as in
+// writer and reader.
+
+const char *const BENCH_NAME = "Lab3Bench";
+const size_t CHANNEL_CAPACITY = 1 << 20;
+
+enum class Test { PingPong, Throughput };
+enum class Pinning { None, Same, Different };
+
+const char *testName(Test test) {
+    return test == Test::PingPong ? "pingpong" : "throughput";
+}
+
+const char *pinningName(Pinning pinning) {
+    return pinning == Pinning::None ? "none" : pinning == Pinning::Same ? "same" : "different";
+}
+
+struct BenchOptions {
+    std::vector<Test> tests = {Test::PingPong, Test::Throughput};
+    // log keeps every message, so it is left out by default: a throughput run
+    // holds messages * size bytes of shared memory.
+    std::vector<std::string> transports = {"ring", "broadcast"};
+    std::vector<size_t> sizes = {16, 64, 256, 1024, 4096};
+    std::vector<Pinning> pinnings = {Pinning::None, Pinning::Same, Pinning::Different};
+    size_t messages = 200'000;
+    size_t roundTrips = 50'000;
+    size_t warmup = 1'000;
+    std::string csvPath;
+};
+
+struct BenchResult {
+    std::string test;
+    std::string transport;
+    std::string pinning;
+    size_t messageSize;
+    size_t messages;
+    double seconds;
+    double messagesPerSecond;
+    double bytesPerSecond;
+    // Round-trip latency in nanoseconds; pingpong only.
+    uint64_t p50 = 0, p99 = 0, p999 = 0, max = 0;
+};
+
+// Log-linear histogram in the style of HdrHistogram: values below 256 are
+// counted exactly, and every power of two above that is split into 128
+// equal buckets, so a reported percentile is within 1% of the true value.
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts(LINEAR + 57 * HALF, 0) {}
+
+    void Record(uint64_t value) {
+        ++counts[IndexOf(value)];
+        ++total;
+        max = std::max(max, value);
+    }
+
+    // Smallest recorded bucket bound that at least fraction of values fall under.
+    uint64_t Percentile(double fraction) const {
+        auto rank = static_cast<uint64_t>(fraction * total + 0.5);
+        uint64_t seen = 0;
+        for (size_t index = 0; index < counts.size(); ++index) {
+            seen += counts[index];
+            if (seen >= rank && seen > 0) return std::min(UpperBound(index), max);
+        }
+        return max;
+    }
+
+    uint64_t maximum() const { return max; }
+
+private:
+    static const uint64_t LINEAR = 256;
+    static const uint64_t HALF = LINEAR / 2;
+
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t max = 0;
+
+    static size_t IndexOf(uint64_t value) {
+        if (value < LINEAR) return static_cast<size_t>(value);
+        unsigned shift = 1;
+        while ((value >> shift) >= LINEAR) ++shift;
+        return static_cast<size_t>(LINEAR + (shift - 1) * HALF + ((value >> shift) - HALF));
+    }
+
+    static uint64_t UpperBound(size_t index) {
+        if (index < LINEAR) return index;
+        uint64_t shift = (index - LINEAR) / HALF + 1;
+        uint64_t bucket = (index - LINEAR) % HALF + HALF;
+        return ((bucket + 1) << shift) - 1;
+    }
+};
+
+// Channels: Create makes the sending end, Open the receiving end, except for
+// RingChannel, whose ends can be made either way round.
+
+class RingChannel {
+public:
+    bool Create(const std::string &name) {
+        SharedSegment::Remove(name);
+        return segment.Create(name, SpscRing::SegmentSize(CHANNEL_CAPACITY)) &&
+               ring.Init(segment.data(), CHANNEL_CAPACITY) && OpenWakeups(name);
+    }
+    bool Open(const std::string &name) {
+        return segment.Open(name) && ring.Attach(segment.data(), segment.size()) && OpenWakeups(name);
+    }
+    void Send(const void *data, size_t length) {
+        writable.Wait([&] { return ring.TryWrite(data, length); });
+        readable.Notify();
+    }
+    void Receive(std::string &message) {
+        readable.Wait([&] { return ring.TryRead(message); });
+        writable.Notify();
+    }
+    size_t maxMessage() const { return ring.maxMessage(); }
+
+private:
+    SharedSegment segment;
+    SpscRing ring;
+    Wakeup readable, writable;
+
+    bool OpenWakeups(const std::string &name) {
+        return readable.Open(ring.readable(), name + ".readable") && writable.Open(ring.writable(), name + ".writable");
+    }
+};
+
+class BroadcastChannel {
+public:
+    bool Create(const std::string &name) {
+        SharedSegment::Remove(name);
+        return segment.Create(name, BroadcastRing::SegmentSize(CHANNEL_CAPACITY)) &&
+               ring.Init(segment.data(), CHANNEL_CAPACITY, OverflowPolicy::Block) && OpenWakeups(name);
+    }
+    bool Open(const std::string &name) {
+        return segment.Open(name) && ring.Attach(segment.data(), segment.size()) && OpenWakeups(name);
+    }
+    void Send(const void *data, size_t length) {
+        writable.Wait([&] { return ring.TryWrite(data, length); });
+        readable.Notify();
+    }
+    void Receive(std::string &message) {
+        readable.Wait([&] { return ring.TryRead(message) != BroadcastRing::ReadResult::Empty; });
+        writable.Notify();
+    }
+    size_t maxMessage() const { return ring.maxMessage(); }
+
+private:
+    SharedSegment segment;
+    BroadcastRing ring;
+    Wakeup readable, writable;
+
+    bool OpenWakeups(const std::string &name) {
+        return readable.Open(ring.readable(), name + ".readable") && writable.Open(ring.writable(), name + ".writable");
+    }
+};
+
+class LogChannel {
+public:
+    ~LogChannel() {
+        if (created) MessageLog::Remove(name);
+    }
+    bool Create(const std::string &name) {
+        this->name = name;
+        created = log.Create(name);
+        return created && appended.Open(log.appended(), name + ".appended");
+    }
+    bool Open(const std::string &name) {
+        return log.Open(name) && appended.Open(log.appended(), name + ".appended");
+    }
+    void Send(const void *data, size_t length) {
+        log.Append(data, length);
+        appended.Notify();
+    }
+    void Receive(std::string &message) {
+        appended.Wait([&] { return log.TryRead(message); });
+    }
+    size_t maxMessage() const { return UINT32_MAX - sizeof(uint32_t); }
+
+private:
+    std::string name;
+    bool created = false;
+    MessageLog log;
+    Wakeup appended;
+};
+
+// Process placement.
+
+std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+#ifdef _WIN32
+    DWORD_PTR processMask, systemMask;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        for (int cpu = 0; cpu < static_cast<int>(sizeof(DWORD_PTR) * 8); ++cpu) {
+            if (processMask & (DWORD_PTR(1) << cpu)) cpus.push_back(cpu);
+        }
+    }
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+#endif
+    return cpus;
+}
+
+void pinCurrentThread(const std::vector<int> &cpus) {
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus) mask |= DWORD_PTR(1) << cpu;
+    SetThreadAffinityMask(GetCurrentThread(), mask);
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#endif
+}
+
+// Peer process.
+
+struct PeerProcess {
+#ifdef _WIN32
+    HANDLE process = NULL;
+#else
+    pid_t pid = -1;
+#endif
+};
+
+bool spawnPeer(const std::vector<std::string> &args, PeerProcess &peer) {
+#ifdef _WIN32
+    char path[MAX_PATH];
+    GetModuleFileNameA(NULL, path, MAX_PATH);
+    std::string commandLine = std::string("\"") + path + "\"";
+    for (const auto &arg : args) commandLine += " " + arg;
+    STARTUPINFOA startup{};
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION info;
+    if (!CreateProcessA(path, &commandLine[0], NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info)) {
+        std::cerr << "Failed to start the peer: " << GetLastError() << "\n";
+        return false;
+    }
+    CloseHandle(info.hThread);
+    peer.process = info.hProcess;
+    return true;
+#else
+    std::vector<std::string> all = {"/proc/self/exe"};
+    all.insert(all.end(), args.begin(), args.end());
+    std::vector<char *> argv;
+    for (auto &arg : all) argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+    int error = posix_spawn(&peer.pid, "/proc/self/exe", nullptr, nullptr, argv.data(), environ);
+    if (error != 0) {
+        std::cerr << "Failed to start the peer: " << error << "\n";
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool waitPeer(PeerProcess &peer) {
+#ifdef _WIN32
+    WaitForSingleObject(peer.process, INFINITE);
+    DWORD code = 1;
+    GetExitCodeProcess(peer.process, &code);
+    CloseHandle(peer.process);
+    return code == 0;
+#else
+    int status = 0;
+    waitpid(peer.pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+std::string forwardName() {
+    return std::string(BENCH_NAME) + ".forward";
+}
+
+std::string replyName() {
+    return std::string(BENCH_NAME) + ".reply";
+}
+
+// Peer side: echoes every pingpong message; for throughput, acknowledges the
+// whole run with the number of bytes it received.
+template <typename Channel>
+int runPeer(Test test, size_t count, int cpu) {
+    if (cpu >= 0) pinCurrentThread({cpu});
+
+    Channel forward;
+    RingChannel reply;
+    if (!forward.Open(forwardName()) || !reply.Open(replyName())) return 1;
+    const char ready = 'R';
+    reply.Send(&ready, 1);
+
+    std::string message;
+    if (test == Test::PingPong) {
+        for (size_t i = 0; i < count; ++i) {
+            forward.Receive(message);
+            reply.Send(message.data(), message.size());
+        }
+    } else {
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < count; ++i) {
+            forward.Receive(message);
+            bytes += message.size();
+        }
+        reply.Send(&bytes, sizeof(bytes));
+    }
+    return 0;
+}
+
+int peerMain(int argc, char *argv[]) {
+    // --peer TRANSPORT TEST COUNT CPU
+    if (argc != 6) return 1;
+    std::string transport = argv[2];
+    Test test = std::string(argv[3]) == "pingpong" ? Test::PingPong : Test::Throughput;
+    auto count = static_cast<size_t>(std::strtoull(argv[4], nullptr, 10));
+    int cpu = std::atoi(argv[5]);
+    if (transport == "ring") return runPeer<RingChannel>(test, count, cpu);
+    if (transport == "broadcast") return runPeer<BroadcastChannel>(test, count, cpu);
+    if (transport == "log") return runPeer<LogChannel>(test, count, cpu);
+    return 1;
+}
+
+// Driver side: one transport, test, size and placement.
+template <typename Channel>
+bool runCase(const BenchOptions &options, const std::string &transport, Test test, size_t size, Pinning pinning,
+             const std::vector<int> &cpus, BenchResult &result) {
+    int driverCpu = pinning == Pinning::None ? -1 : cpus[0];
+    int peerCpu = pinning == Pinning::None ? -1 : pinning == Pinning::Same ? cpus[0] : cpus[1];
+
+    Channel forward;
+    RingChannel reply;
+    if (!forward.Create(forwardName()) || !reply.Create(replyName())) return false;
+    if (size > forward.maxMessage()) {
+        std::cerr << "Message size " << size << " exceeds the " << transport << " limit\n";
+        return false;
+    }
+
+    size_t count = test == Test::PingPong ? options.warmup + options.roundTrips : options.messages;
+    PeerProcess peer;
+    if (!spawnPeer({"--peer", transport, testName(test), std::to_string(count), std::to_string(peerCpu)}, peer)) {
+        return false;
+    }
+    if (driverCpu >= 0) pinCurrentThread({driverCpu});
+
+    std::string payload(size, 'x');
+    std::string message;
+    reply.Receive(message);
+
+    result = {testName(test), transport, pinningName(pinning), size, 0, 0, 0, 0};
+    bool ok = true;
+    auto start = std::chrono::steady_clock::now();
+    if (test == Test::PingPong) {
+        LatencyHistogram histogram;
+        for (size_t i = 0; i < count; ++i) {
+            auto sent = std::chrono::steady_clock::now();
+            forward.Send(payload.data(), payload.size());
+            reply.Receive(message);
+            auto received = std::chrono::steady_clock::now();
+            if (i == options.warmup) start = sent;
+            if (i >= options.warmup) {
+                histogram.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(received - sent).count());
+            }
+            ok = ok && message.size() == size;
+        }
+        result.messages = options.roundTrips;
+        result.p50 = histogram.Percentile(0.5);
+        result.p99 = histogram.Percentile(0.99);
+        result.p999 = histogram.Percentile(0.999);
+        result.max = histogram.maximum();
+    } else {
+        for (size_t i = 0; i < count; ++i) forward.Send(payload.data(), payload.size());
+        reply.Receive(message);
+        uint64_t bytes = 0;
+        if (message.size() == sizeof(bytes)) memcpy(&bytes, message.data(), sizeof(bytes));
+        ok = bytes == uint64_t(count) * size;
+        result.messages = count;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.messagesPerSecond = result.messages / result.seconds;
+    result.bytesPerSecond = result.messagesPerSecond * size;
+
+    if (driverCpu >= 0) pinCurrentThread(cpus);
+    ok = waitPeer(peer) && ok;
+    SharedSegment::Remove(forwardName());
+    SharedSegment::Remove(replyName());
+    if (!ok) std::cerr << "Peer reported a mismatch\n";
+    return ok;
+}
+
+std::vector<std::string> splitList(const std::string &value) {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+bool parseOptions(int argc, char *argv[], BenchOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string name = arg;
+        std::string value;
+        size_t equals = arg.find('=');
+        if (equals != std::string::npos) {
+            name = arg.substr(0, equals);
+            value = arg.substr(equals + 1);
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        } else {
+            return false;
+        }
+
+        if (name == "--tests") {
+            options.tests.clear();
+            for (const auto &item : splitList(value)) {
+                if (item == "pingpong") {
+                    options.tests.push_back(Test::PingPong);
+                } else if (item == "throughput") {
+                    options.tests.push_back(Test::Throughput);
+                } else {
+                    return false;
+                }
+            }
+            if (options.tests.empty()) return false;
+        } else if (name == "--transports") {
+            options.transports = splitList(value);
+            for (const auto &item : options.transports) {
+                if (item != "ring" && item != "broadcast" && item != "log") return false;
+            }
+            if (options.transports.empty()) return false;
+        } else if (name == "--sizes") {
+            options.sizes.clear();
+            for (const auto &item : splitList(value)) {
+                size_t size = std::strtoull(item.c_str(), nullptr, 10);
+                if (size == 0) return false;
+                options.sizes.push_back(size);
+            }
+            if (options.sizes.empty()) return false;
+        } else if (name == "--pinning") {
+            options.pinnings.clear();
+            for (const auto &item : splitList(value)) {
+                if (item == "none") {
+                    options.pinnings.push_back(Pinning::None);
+                } else if (item == "same") {
+                    options.pinnings.push_back(Pinning::Same);
+                } else if (item == "different") {
+                    options.pinnings.push_back(Pinning::Different);
+                } else {
+                    return false;
+                }
+            }
+            if (options.pinnings.empty()) return false;
+        } else if (name == "--messages") {
+            options.messages = static_cast<size_t>(std::strtod(value.c_str(), nullptr));
+            if (options.messages == 0) return false;
+        } else if (name == "--round-trips") {
+            options.roundTrips = static_cast<size_t>(std::strtod(value.c_str(), nullptr));
+            if (options.roundTrips == 0) return false;
+        } else if (name == "--warmup") {
+            options.warmup = static_cast<size_t>(std::strtod(value.c_str(), nullptr));
+        } else if (name == "--csv") {
+            options.csvPath = value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+void writeCsv(std::ostream &out, const std::vector<BenchResult> &results) {
+    out << "test,transport,pinning,message_size,messages,seconds,messages_per_second,bytes_per_second,"
+           "p50_ns,p99_ns,p999_ns,max_ns\n";
+    for (const auto &result : results) {
+        out << result.test << ',' << result.transport << ',' << result.pinning << ',' << result.messageSize << ','
+            << result.messages << ',' << result.seconds << ',' << result.messagesPerSecond << ','
+            << result.bytesPerSecond << ',';
+        if (result.test == "pingpong") {
+            out << result.p50 << ',' << result.p99 << ',' << result.p999 << ',' << result.max;
+        } else {
+            out << ",,,";
+        }
+        out << '\n';
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--peer") {
+        return peerMain(argc, argv);
+    }
+
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--tests pingpong,throughput] [--transports ring,broadcast,log]"
+                  << " [--sizes N,...] [--pinning none,same,different] [--messages N] [--round-trips N]"
+                  << " [--warmup N] [--csv FILE]\n";
+        return 1;
+    }
+
+    std::vector<int> cpus = allowedCpus();
+    std::vector<BenchResult> results;
+    for (Pinning pinning : options.pinnings) {
+        size_t needed = pinning == Pinning::None ? 0 : pinning == Pinning::Same ? 1 : 2;
+        if (cpus.size() < needed) {
+            std::cerr << "Skipping pinning=" << pinningName(pinning) << ": only " << cpus.size() << " CPU(s) allowed\n";
+            continue;
+        }
+        for (const auto &transport : options.transports) {
+            for (Test test : options.tests) {
+                for (size_t size : options.sizes) {
+                    BenchResult result;
+                    bool ok;
+                    if (transport == "ring") {
+                        ok = runCase<RingChannel>(options, transport, test, size, pinning, cpus, result);
+                    } else if (transport == "broadcast") {
+                        ok = runCase<BroadcastChannel>(options, transport, test, size, pinning, cpus, result);
+                    } else {
+                        ok = runCase<LogChannel>(options, transport, test, size, pinning, cpus, result);
+                    }
+                    if (!ok) return 1;
+
+                    std::cerr << result.test << " " << transport << " pinning=" << result.pinning << " size=" << size
+                              << ": " << result.messagesPerSecond / 1e6 << " M msg/s, "
+                              << result.bytesPerSecond / (1 << 20) << " MiB/s";
+                    if (test == Test::PingPong) {
+                        std::cerr << ", p50 " << result.p50 << " ns, p99 " << result.p99 << " ns, p99.9 "
+                                  << result.p999 << " ns";
+                    }
+                    std::cerr << "\n";
+                    results.push_back(result);
+                }
+            }
+        }
+    }
+
+    if (options.csvPath.empty()) {
+        writeCsv(std::cout, results);
+    } else {
+        std::ofstream csv(options.csvPath);
+        writeCsv(csv, results);
+        if (!csv) {
+            std::cerr << "Failed to write " << options.csvPath << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
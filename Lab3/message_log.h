@@ -0,0 +1,182 @@
+#ifndef LAB3_MESSAGE_LOG_H
+#define LAB3_MESSAGE_LOG_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "shared_segment.h"
+#include "wakeup.h"
+
+// Append-only message log in a chain of shared segments named name.log.0,
+// name.log.1, ... Unlike the ring, nothing is ever overwritten, so any
+// number of readers can follow the log, each from its own cursor, and a
+// reader started late still sees every message.
+//
+// Every segment starts with a header giving its index, size, the log offset
+// of its first byte (base) and the number of data bytes published (used).
+// Messages are a 32-bit length followed by the payload, padded to 8 bytes.
+// An append copies only the new message and publishes it with a release
+// store of used. When a message does not fit, the writer creates the next
+// segment, at least twice as large and big enough for the message, and then
+// seals the current one; a reader that reaches the end of a sealed segment
+// moves on to the next. The wakeup word lives in segment 0, which both
+// sides keep mapped.
+class MessageLog {
+public:
+    static const size_t INITIAL_SEGMENT = 64 * 1024;
+    static const size_t MAX_GROWTH_SEGMENT = 64 * 1024 * 1024;
+
+    // Writer side: starts an empty log, discarding any old one under name.
+    bool Create(const std::string &name);
+    // Reader side: opens the log with the cursor at its first message.
+    bool Open(const std::string &name);
+
+    bool Append(const void *data, size_t length);
+    // Copies out the message at the cursor and advances past it; false if
+    // the reader has caught up with the writer.
+    bool TryRead(std::string &message);
+
+    // Log offset of the next message to read.
+    uint64_t cursor() const { return current()->base + offset; }
+    size_t segmentCount() const { return segments.size(); }
+    WakeupWord *appended() const { return &HeaderOf(*segments.front())->appended; }
+
+    // Removes the names of every segment of the log called name.
+    static void Remove(const std::string &name);
+
+private:
+    static const uint32_t MAGIC = 0x31474F4C; // "LOG1"
+    static const size_t ALIGNMENT = 8;
+
+    struct SegmentHeader {
+        uint32_t magic;
+        uint32_t index;
+        uint64_t size;
+        uint64_t base;
+        alignas(64) std::atomic<uint64_t> used;
+        std::atomic<uint32_t> sealed;
+        alignas(64) WakeupWord appended;
+    };
+    // Data starts on the cache line after the header.
+    static const size_t DATA_OFFSET = sizeof(SegmentHeader);
+
+    std::string name;
+    // The writer keeps every segment mapped, so none disappears on Windows
+    // before a slow reader opens it. A reader keeps segment 0, for the
+    // wakeup word, and the one it is reading.
+    std::vector<std::unique_ptr<SharedSegment>> segments;
+    uint64_t offset = 0;
+
+    static std::string SegmentName(const std::string &name, uint32_t index) {
+        return name + ".log." + std::to_string(index);
+    }
+    static SegmentHeader *HeaderOf(const SharedSegment &segment) {
+        return static_cast<SegmentHeader *>(segment.data());
+    }
+    static char *DataOf(SegmentHeader *header) { return reinterpret_cast<char *>(header) + DATA_OFFSET; }
+    static uint64_t Align(uint64_t size) { return (size + ALIGNMENT - 1) & ~uint64_t(ALIGNMENT - 1); }
+
+    SegmentHeader *current() const { return HeaderOf(*segments.back()); }
+    uint64_t capacity() const { return current()->size - DATA_OFFSET; }
+    bool AddSegment(uint32_t index, size_t size, uint64_t base);
+    bool OpenSegment(uint32_t index);
+};
+
+inline void MessageLog::Remove(const std::string &name) {
+    for (uint32_t index = 0; SharedSegment::Remove(SegmentName(name, index)); ++index) {
+    }
+}
+
+inline bool MessageLog::AddSegment(uint32_t index, size_t size, uint64_t base) {
+    std::unique_ptr<SharedSegment> segment(new SharedSegment);
+    if (!segment->Create(SegmentName(name, index), size)) return false;
+    SegmentHeader *header = HeaderOf(*segment);
+    header->index = index;
+    header->size = size;
+    header->base = base;
+    header->used.store(0, std::memory_order_relaxed);
+    header->sealed.store(0, std::memory_order_relaxed);
+    header->appended.sequence.store(0, std::memory_order_relaxed);
+    header->appended.waiters.store(0, std::memory_order_relaxed);
+    header->magic = MAGIC;
+    segments.push_back(std::move(segment));
+    return true;
+}
+
+inline bool MessageLog::OpenSegment(uint32_t index) {
+    std::unique_ptr<SharedSegment> segment(new SharedSegment);
+    if (!segment->Open(SegmentName(name, index))) return false;
+    const SegmentHeader *header = HeaderOf(*segment);
+    if (segment->size() < DATA_OFFSET || header->magic != MAGIC || header->index != index ||
+        segment->size() < header->size) {
+        std::cerr << "Сегмент журнала " << index << " повреждён." << std::endl;
+        return false;
+    }
+    // Keep segment 0 and the new one; the one just finished is not needed.
+    if (segments.size() > 1) segments.pop_back();
+    segments.push_back(std::move(segment));
+    offset = 0;
+    return true;
+}
+
+inline bool MessageLog::Create(const std::string &name) {
+    this->name = name;
+    segments.clear();
+    offset = 0;
+    Remove(name);
+    return AddSegment(0, INITIAL_SEGMENT, 0);
+}
+
+inline bool MessageLog::Open(const std::string &name) {
+    this->name = name;
+    segments.clear();
+    return OpenSegment(0);
+}
+
+inline bool MessageLog::Append(const void *data, size_t length) {
+    if (length > UINT32_MAX - sizeof(uint32_t)) return false;
+    SegmentHeader *header = current();
+    uint64_t used = header->used.load(std::memory_order_relaxed);
+    uint64_t needed = Align(sizeof(uint32_t) + length);
+
+    if (used + needed > capacity()) {
+        size_t size = std::min<size_t>(header->size * 2, MAX_GROWTH_SEGMENT);
+        while (size < DATA_OFFSET + needed) size *= 2;
+        if (!AddSegment(header->index + 1, size, header->base + used)) return false;
+        // The next segment exists before readers are told to move on.
+        header->sealed.store(1, std::memory_order_release);
+        header = current();
+        used = 0;
+    }
+
+    auto storedLength = static_cast<uint32_t>(length);
+    memcpy(DataOf(header) + used, &storedLength, sizeof(storedLength));
+    memcpy(DataOf(header) + used + sizeof(storedLength), data, length);
+    header->used.store(used + needed, std::memory_order_release);
+    return true;
+}
+
+inline bool MessageLog::TryRead(std::string &message) {
+    SegmentHeader *header = current();
+    if (offset == header->used.load(std::memory_order_acquire)) {
+        if (!header->sealed.load(std::memory_order_acquire)) return false;
+        // used is final once the segment is sealed, but may have grown since
+        // the first load.
+        if (offset == header->used.load(std::memory_order_acquire)) {
+            return OpenSegment(header->index + 1) && TryRead(message);
+        }
+    }
+
+    uint32_t length;
+    memcpy(&length, DataOf(header) + offset, sizeof(length));
+    message.assign(DataOf(header) + offset + sizeof(length), length);
+    offset += Align(sizeof(length) + length);
+    return true;
+}
+
+#endif //LAB3_MESSAGE_LOG_H
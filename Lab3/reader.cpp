@@ -1,66 +1,135 @@
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <iostream>
+#include <string>
+#include "broadcast_ring.h"
+#include "message_log.h"
+#include "shared_segment.h"
+#include "spsc_ring.h"
 
-const int BUF_SIZE = 256;
+const char* SEGMENT_NAME = "MySharedMemory1";
 
-int main() {
-    SetConsoleOutputCP(CP_UTF8);
+// Prints messages as read fills them in, until 'exit' or read returns false.
+template <typename Read>
+void PrintLoop(Read read) {
+    std::string message;
+    while (true) {
+        if (!read(message)) {
+            break;
+        }
+        if (message == "exit") {
+            std::cout << "Получен сигнал на завершение. Закрытие Reader." << std::endl;
+            break;
+        }
+        std::cout << "Прочитано из разделяемой памяти: " << message << std::endl;
+    }
+}
 
-    HANDLE hMapFile = OpenFileMappingW(
-            FILE_MAP_ALL_ACCESS,
-            FALSE,
-            L"Local\\MySharedMemory1"
-    );
+int RunRing() {
+    SharedSegment segment;
+    if (!segment.Open(SEGMENT_NAME)) {
+        return 1;
+    }
 
-    if (hMapFile == NULL) {
-        std::cerr << "Не удалось открыть разделяемую память: " << GetLastError() << std::endl;
+    SpscRing ring;
+    if (!ring.Attach(segment.data(), segment.size())) {
+        std::cerr << "Разделяемая память не содержит кольцевого буфера." << std::endl;
         return 1;
     }
 
-    LPCTSTR pBuf = (LPTSTR)MapViewOfFile(
-            hMapFile,
-            FILE_MAP_ALL_ACCESS,
-            0,
-            0,
-            BUF_SIZE
-    );
-
-    if (pBuf == NULL) {
-        std::cerr << "Не удалось отобразить разделяемую память: " << GetLastError() << std::endl;
-        CloseHandle(hMapFile);
+    Wakeup readable, writable;
+    if (!readable.Open(ring.readable(), std::string(SEGMENT_NAME) + ".readable") ||
+        !writable.Open(ring.writable(), std::string(SEGMENT_NAME) + ".writable")) {
         return 1;
     }
 
-    HANDLE hMutex = OpenMutexW(
-            MUTEX_ALL_ACCESS,
-            FALSE,
-            L"Local\\Mutex12"
-    );
+    PrintLoop([&](std::string &message) {
+        // Blocks until the writer publishes; no polling while idle.
+        readable.Wait([&] { return ring.TryRead(message); });
+        writable.Notify();
+        return true;
+    });
+    return 0;
+}
 
-    if (hMutex == NULL) {
-        std::cerr << "Не удалось открыть мьютекс: " << GetLastError() << std::endl;
-        UnmapViewOfFile(pBuf);
-        CloseHandle(hMapFile);
+int RunLog() {
+    MessageLog log;
+    if (!log.Open(SEGMENT_NAME)) {
         return 1;
     }
 
-    while (true) {
-        WaitForSingleObject(hMutex, INFINITE);
-        std::cout << "Прочитано из разделяемой памяти:" << std::endl;
-        if (strcmp((const char*)pBuf, "exit") == 0) {
-            std::cout << "Получен сигнал на завершение. Закрытие Reader." << std::endl;
-            ReleaseMutex(hMutex);
-            break;
-        }
-        std::cout << pBuf << std::endl;
+    Wakeup appended;
+    if (!appended.Open(log.appended(), std::string(SEGMENT_NAME) + ".appended")) {
+        return 1;
+    }
 
-        ReleaseMutex(hMutex);
-        Sleep(100);
+    // Starts from the first message, however late the reader joins.
+    PrintLoop([&](std::string &message) {
+        appended.Wait([&] { return log.TryRead(message); });
+        return true;
+    });
+    return 0;
+}
+
+int RunBroadcast() {
+    SharedSegment segment;
+    if (!segment.Open(SEGMENT_NAME)) {
+        return 1;
     }
 
-    UnmapViewOfFile(pBuf);
-    CloseHandle(hMapFile);
-    CloseHandle(hMutex);
+    BroadcastRing ring;
+    if (!ring.Attach(segment.data(), segment.size())) {
+        std::cerr << "Не удалось подключиться: это не широковещательный буфер или все " << BroadcastRing::MAX_READERS
+                  << " мест заняты." << std::endl;
+        return 1;
+    }
 
+    Wakeup readable, writable;
+    if (!readable.Open(ring.readable(), std::string(SEGMENT_NAME) + ".readable") ||
+        !writable.Open(ring.writable(), std::string(SEGMENT_NAME) + ".writable")) {
+        return 1;
+    }
+
+    uint64_t reportedLost = 0;
+    PrintLoop([&](std::string &message) {
+        auto result = BroadcastRing::ReadResult::Empty;
+        readable.Wait([&] {
+            result = ring.TryRead(message);
+            return result != BroadcastRing::ReadResult::Empty;
+        });
+        // Lets a writer blocked on this reader carry on.
+        writable.Notify();
+
+        if (result == BroadcastRing::ReadResult::Detached) {
+            std::cout << "Writer отключил Reader за отставание." << std::endl;
+            return false;
+        }
+        if (ring.lost() != reportedLost) {
+            std::cout << "Пропущено сообщений: " << ring.lost() - reportedLost << std::endl;
+            reportedLost = ring.lost();
+        }
+        return true;
+    });
     return 0;
-}
\ No newline at end of file
+}
+
+// Usage: reader [ring|log|broadcast], matching the writer's mode.
+int main(int argc, char *argv[]) {
+#ifdef _WIN32
+    SetConsoleOutputCP(CP_UTF8);
+#endif
+
+    std::string transport = argc > 1 ? argv[1] : "ring";
+    if (transport == "log") {
+        return RunLog();
+    }
+    if (transport == "broadcast") {
+        return RunBroadcast();
+    }
+    if (transport != "ring") {
+        std::cerr << "Неизвестный режим: " << transport << " (ожидается ring, log или broadcast)." << std::endl;
+        return 1;
+    }
+    return RunRing();
+}
@@ -0,0 +1,154 @@
+#ifndef LAB3_SHARED_SEGMENT_H
+#define LAB3_SHARED_SEGMENT_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Named shared memory visible to other processes: a named file mapping
+// (Local\name) on Windows, a POSIX shm_open object (/name) on Linux.
+class SharedSegment {
+public:
+    SharedSegment() = default;
+    SharedSegment(const SharedSegment &) = delete;
+    SharedSegment &operator=(const SharedSegment &) = delete;
+    ~SharedSegment() { Close(); }
+
+    // Creates the segment, or reuses and resizes an existing one, zero-filled
+    // when new.
+    bool Create(const std::string &name, size_t size);
+    // Maps a segment created by another process.
+    bool Open(const std::string &name);
+    void Close();
+    // Removes the name; processes that mapped the segment keep it. False if
+    // there was no such segment. A no-op on Windows, where the mapping lives
+    // until its last handle closes.
+    static bool Remove(const std::string &name);
+
+    void *data() const { return view; }
+    size_t size() const { return viewSize; }
+
+private:
+    void *view = nullptr;
+    size_t viewSize = 0;
+#ifdef _WIN32
+    HANDLE hMapFile = NULL;
+
+    static std::string FullName(const std::string &name) { return "Local\\" + name; }
+#else
+    static std::string FullName(const std::string &name) { return "/" + name; }
+    bool Map(int fd, size_t size);
+#endif
+};
+
+#ifdef _WIN32
+inline bool SharedSegment::Create(const std::string &name, size_t size) {
+    hMapFile = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, static_cast<DWORD>(size >> 32),
+                                  static_cast<DWORD>(size), FullName(name).c_str());
+    if (hMapFile == NULL) {
+        std::cerr << "Не удалось создать разделяемую память: " << GetLastError() << std::endl;
+        return false;
+    }
+    view = MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (view == NULL) {
+        std::cerr << "Не удалось отобразить разделяемую память: " << GetLastError() << std::endl;
+        Close();
+        return false;
+    }
+    viewSize = size;
+    return true;
+}
+
+inline bool SharedSegment::Open(const std::string &name) {
+    hMapFile = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, FullName(name).c_str());
+    if (hMapFile == NULL) {
+        std::cerr << "Не удалось открыть разделяемую память: " << GetLastError() << std::endl;
+        return false;
+    }
+    view = MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (view == NULL) {
+        std::cerr << "Не удалось отобразить разделяемую память: " << GetLastError() << std::endl;
+        Close();
+        return false;
+    }
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(view, &info, sizeof(info));
+    viewSize = info.RegionSize;
+    return true;
+}
+
+inline void SharedSegment::Close() {
+    if (view) UnmapViewOfFile(view);
+    if (hMapFile) CloseHandle(hMapFile);
+    view = nullptr;
+    hMapFile = NULL;
+    viewSize = 0;
+}
+
+inline bool SharedSegment::Remove(const std::string &) {
+    return false;
+}
+#else
+inline bool SharedSegment::Map(int fd, size_t size) {
+    view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        std::cerr << "Не удалось отобразить разделяемую память: " << errno << std::endl;
+        view = nullptr;
+        return false;
+    }
+    viewSize = size;
+    return true;
+}
+
+inline bool SharedSegment::Create(const std::string &name, size_t size) {
+    int fd = shm_open(FullName(name).c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd == -1) {
+        std::cerr << "Не удалось создать разделяемую память: " << errno << std::endl;
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) == -1) {
+        std::cerr << "Не удалось задать размер разделяемой памяти: " << errno << std::endl;
+        close(fd);
+        return false;
+    }
+    return Map(fd, size);
+}
+
+inline bool SharedSegment::Open(const std::string &name) {
+    int fd = shm_open(FullName(name).c_str(), O_RDWR, 0);
+    if (fd == -1) {
+        std::cerr << "Не удалось открыть разделяемую память: " << errno << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1 || info.st_size == 0) {
+        std::cerr << "Не удалось определить размер разделяемой памяти: " << errno << std::endl;
+        close(fd);
+        return false;
+    }
+    return Map(fd, static_cast<size_t>(info.st_size));
+}
+
+inline void SharedSegment::Close() {
+    if (view) munmap(view, viewSize);
+    view = nullptr;
+    viewSize = 0;
+}
+
+inline bool SharedSegment::Remove(const std::string &name) {
+    return shm_unlink(FullName(name).c_str()) == 0;
+}
+#endif
+
+#endif //LAB3_SHARED_SEGMENT_H
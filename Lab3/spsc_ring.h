@@ -0,0 +1,167 @@
+#ifndef LAB3_SPSC_RING_H
+#define LAB3_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "wakeup.h"
+
+// Single-producer/single-consumer ring of length-prefixed messages, laid out
+// in shared memory so the writer and reader can live in different processes.
+//
+// The segment holds a header, then capacity bytes of data. head counts the
+// bytes ever written and tail the bytes ever consumed; each index has a
+// cache line of its own and only one side stores to it. The writer fills a
+// message and then publishes it with a release store of head; the reader
+// acquires head, copies the message out and releases it with a store of
+// tail. Neither side takes a lock.
+//
+// A message is a 32-bit length followed by the payload, padded to 8 bytes,
+// and never wraps: if it does not fit before the end of the data area the
+// writer leaves a WRAP marker and starts again at offset 0.
+//
+// The header also carries two WakeupWords, so either side can park instead
+// of polling: readable for a reader facing an empty ring, writable for a
+// writer facing a full one. The ring itself never blocks; callers pair
+// TryWrite/Consume with Wakeup::Notify and retry inside Wakeup::Wait.
+class SpscRing {
+public:
+    static size_t SegmentSize(size_t capacity) { return sizeof(Header) + capacity; }
+
+    // Writer side: formats memory of SegmentSize(capacity) bytes as an empty
+    // ring. capacity must be a power of two.
+    bool Init(void *memory, size_t capacity);
+    // Reader side: attaches to a ring formatted by Init.
+    bool Attach(void *memory, size_t size);
+
+    // Largest payload a single message can carry.
+    size_t maxMessage() const { return capacity / 2 - sizeof(uint32_t); }
+
+    // Publishes a message; false if the ring has no room for it right now.
+    bool TryWrite(const void *data, size_t length);
+    // Points message at the next unread payload without copying; false if
+    // the ring is empty. The payload stays valid until Consume.
+    bool Peek(const char *&message, size_t &length);
+    // Releases the message returned by the last Peek.
+    void Consume();
+    // Copies out and consumes the next message; false if the ring is empty.
+    bool TryRead(std::string &message);
+
+    WakeupWord *readable() const { return &header->readable; }
+    WakeupWord *writable() const { return &header->writable; }
+
+private:
+    static const uint32_t MAGIC = 0x474E4952; // "RING"
+    static const uint32_t WRAP = UINT32_MAX;
+    static const size_t ALIGNMENT = 8;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t reserved;
+        uint64_t capacity;
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+        alignas(64) WakeupWord readable;
+        alignas(64) WakeupWord writable;
+        alignas(64) char data[1];
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring indices must be lock-free to be shared");
+
+    Header *header = nullptr;
+    uint64_t capacity = 0;
+    // Each side's private copy of the other side's index, refreshed only
+    // when the ring looks full or empty. Kept on separate cache lines, since
+    // the two sides may be threads of one process sharing this object.
+    alignas(64) uint64_t cachedTail = 0;
+    alignas(64) uint64_t cachedHead = 0;
+    uint64_t peekedEnd = 0;
+
+    static uint64_t Align(uint64_t size) { return (size + ALIGNMENT - 1) & ~uint64_t(ALIGNMENT - 1); }
+    char *At(uint64_t position) const { return header->data + (position & (capacity - 1)); }
+};
+
+inline bool SpscRing::Init(void *memory, size_t capacity) {
+    if (capacity < 64 || (capacity & (capacity - 1)) != 0) return false;
+    header = static_cast<Header *>(memory);
+    header->capacity = capacity;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    for (WakeupWord *word : {&header->readable, &header->writable}) {
+        word->sequence.store(0, std::memory_order_relaxed);
+        word->waiters.store(0, std::memory_order_relaxed);
+    }
+    header->magic = MAGIC;
+    this->capacity = capacity;
+    cachedTail = cachedHead = peekedEnd = 0;
+    return true;
+}
+
+inline bool SpscRing::Attach(void *memory, size_t size) {
+    auto *existing = static_cast<Header *>(memory);
+    if (size < sizeof(Header) || existing->magic != MAGIC || size < SegmentSize(existing->capacity)) return false;
+    header = existing;
+    capacity = existing->capacity;
+    cachedHead = header->head.load(std::memory_order_acquire);
+    peekedEnd = cachedHead;
+    return true;
+}
+
+inline bool SpscRing::TryWrite(const void *data, size_t length) {
+    if (length > maxMessage()) return false;
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    uint64_t needed = Align(sizeof(uint32_t) + length);
+    uint64_t untilEnd = capacity - (head & (capacity - 1));
+    uint64_t total = needed <= untilEnd ? needed : untilEnd + needed;
+
+    if (head + total - cachedTail > capacity) {
+        cachedTail = header->tail.load(std::memory_order_acquire);
+        if (head + total - cachedTail > capacity) return false;
+    }
+
+    if (needed > untilEnd) {
+        uint32_t wrap = WRAP;
+        memcpy(At(head), &wrap, sizeof(wrap));
+        head += untilEnd;
+    }
+    auto storedLength = static_cast<uint32_t>(length);
+    memcpy(At(head), &storedLength, sizeof(storedLength));
+    memcpy(At(head) + sizeof(storedLength), data, length);
+    header->head.store(head + needed, std::memory_order_release);
+    return true;
+}
+
+inline bool SpscRing::Peek(const char *&message, size_t &length) {
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    if (tail == cachedHead) {
+        cachedHead = header->head.load(std::memory_order_acquire);
+        if (tail == cachedHead) return false;
+    }
+
+    uint32_t storedLength;
+    memcpy(&storedLength, At(tail), sizeof(storedLength));
+    if (storedLength == WRAP) {
+        tail += capacity - (tail & (capacity - 1));
+        memcpy(&storedLength, At(tail), sizeof(storedLength));
+    }
+    message = At(tail) + sizeof(storedLength);
+    length = storedLength;
+    peekedEnd = tail + Align(sizeof(storedLength) + storedLength);
+    return true;
+}
+
+inline void SpscRing::Consume() {
+    header->tail.store(peekedEnd, std::memory_order_release);
+}
+
+inline bool SpscRing::TryRead(std::string &message) {
+    const char *payload;
+    size_t length;
+    if (!Peek(payload, length)) return false;
+    message.assign(payload, length);
+    Consume();
+    return true;
+}
+
+#endif //LAB3_SPSC_RING_H
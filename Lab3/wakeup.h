@@ -0,0 +1,173 @@
+#ifndef LAB3_WAKEUP_H
+#define LAB3_WAKEUP_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define LAB3_CPU_RELAX() _mm_pause()
+#else
+#define LAB3_CPU_RELAX() ((void)0)
+#endif
+
+// Notification state kept in the shared segment next to the data it
+// announces. sequence changes on every wake and is the futex word on Linux;
+// waiters counts parked consumers, so a producer only makes a system call
+// when someone sleeps.
+struct WakeupWord {
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> waiters;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "wakeup word must be lock-free to be shared");
+
+// Per-process handle on a WakeupWord. Linux uses a shared futex on the word
+// itself. On Windows WaitOnAddress does not work across processes, so a
+// named semaphore stands in for the futex; Notify releases one count per
+// parked waiter, so several consumers can share a word.
+//
+// Wait spins for a while before parking. The spin budget adapts: it doubles
+// whenever data arrives while spinning (load is sustained, parking would only
+// add latency) and halves whenever the consumer has to park (it is idle, and
+// spinning only burns CPU), within [MIN_SPINS, MAX_SPINS].
+class Wakeup {
+public:
+    static const unsigned MIN_SPINS = 64;
+    static const unsigned MAX_SPINS = 1 << 16;
+
+    Wakeup() = default;
+    Wakeup(const Wakeup &) = delete;
+    Wakeup &operator=(const Wakeup &) = delete;
+    ~Wakeup() { Close(); }
+
+    // name identifies the Windows semaphore and is unused on Linux.
+    bool Open(WakeupWord *word, const std::string &name);
+    void Close();
+
+    // Producer side: call after publishing data.
+    void Notify();
+
+    // Consumer side: returns once poll() returns true, or false once
+    // timeoutMs have passed (0 waits forever). poll must consume the data it
+    // reports.
+    template <typename Poll>
+    bool Wait(Poll poll, unsigned timeoutMs = 0);
+
+    unsigned spinBudget() const { return spins; }
+    unsigned long long parks() const { return parkCount; }
+
+private:
+    WakeupWord *word = nullptr;
+    unsigned spins = 1024;
+    unsigned long long parkCount = 0;
+#ifdef _WIN32
+    HANDLE semaphore = NULL;
+#endif
+
+    // Sleeps until Notify changes the sequence from seen, or timeoutMs.
+    void Park(uint32_t seen, unsigned timeoutMs);
+};
+
+#ifdef _WIN32
+inline bool Wakeup::Open(WakeupWord *word, const std::string &name) {
+    this->word = word;
+    semaphore = CreateSemaphoreA(NULL, 0, LONG_MAX, ("Local\\" + name + ".wakeup").c_str());
+    if (semaphore == NULL) {
+        std::cerr << "Не удалось создать семафор: " << GetLastError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline void Wakeup::Close() {
+    if (semaphore) CloseHandle(semaphore);
+    semaphore = NULL;
+}
+
+inline void Wakeup::Park(uint32_t, unsigned timeoutMs) {
+    WaitForSingleObject(semaphore, timeoutMs ? timeoutMs : INFINITE);
+}
+#else
+inline bool Wakeup::Open(WakeupWord *word, const std::string &) {
+    this->word = word;
+    return true;
+}
+
+inline void Wakeup::Close() {}
+
+inline void Wakeup::Park(uint32_t seen, unsigned timeoutMs) {
+    timespec timeout{static_cast<time_t>(timeoutMs / 1000), static_cast<long>(timeoutMs % 1000) * 1000000};
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word->sequence), FUTEX_WAIT, seen,
+            timeoutMs ? &timeout : nullptr, nullptr, 0);
+}
+#endif
+
+inline void Wakeup::Notify() {
+    // Pairs with the fence in Wait: either the consumer sees the data before
+    // parking or this side sees it waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t waiters = word->waiters.load(std::memory_order_relaxed);
+    if (waiters == 0) return;
+    word->sequence.fetch_add(1, std::memory_order_release);
+#ifdef _WIN32
+    // Counts left over by waiters that woke on their own only cause a
+    // spurious wakeup later.
+    ReleaseSemaphore(semaphore, static_cast<LONG>(waiters), NULL);
+#else
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word->sequence), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+template <typename Poll>
+bool Wakeup::Wait(Poll poll, unsigned timeoutMs) {
+    for (unsigned spin = 0; spin < spins; ++spin) {
+        if (poll()) {
+            if (spin > 0) spins = std::min(spins * 2, MAX_SPINS);
+            return true;
+        }
+        LAB3_CPU_RELAX();
+        // Let the producer run if it shares this core.
+        if (spin % 64 == 63) std::this_thread::yield();
+    }
+
+    spins = std::max(spins / 2, MIN_SPINS);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;) {
+        unsigned remainingMs = 0;
+        if (timeoutMs) {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0) return false;
+            remainingMs = static_cast<unsigned>(remaining.count());
+        }
+
+        uint32_t seen = word->sequence.load(std::memory_order_acquire);
+        word->waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (poll()) {
+            word->waiters.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        ++parkCount;
+        Park(seen, remainingMs);
+        word->waiters.fetch_sub(1, std::memory_order_relaxed);
+        if (poll()) return true;
+    }
+}
+
+#endif //LAB3_WAKEUP_H
@@ -1,81 +1,166 @@
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <iostream>
+#include <string>
+#include "broadcast_ring.h"
+#include "message_log.h"
+#include "shared_segment.h"
+#include "spsc_ring.h"
+
+const char* SEGMENT_NAME = "MySharedMemory1";
+const size_t RING_CAPACITY = 1 << 20;
+// How often a writer blocked on a full broadcast ring checks for dead readers.
+const unsigned REAP_INTERVAL_MS = 100;
+
+// Publishes message, parking while the ring is full, and wakes the reader
+// if it is parked.
+void WriteMessage(SpscRing &ring, Wakeup &readable, Wakeup &writable, const std::string &message) {
+    writable.Wait([&] { return ring.TryWrite(message.data(), message.size()); });
+    readable.Notify();
+}
+
+// Prompts for messages until 'exit' (or end of input) and hands each to send,
+// which returns false if the message could not be sent.
+template <typename Send>
+void PromptLoop(Send send) {
+    while (true) {
+        std::cout << "Введите сообщение для записи в разделяемую память (введите 'exit' для выхода): ";
+        std::string input;
+        if (!std::getline(std::cin, input)) {
+            input = "exit";
+        }
 
-const int BUF_SIZE = 256;
+        if (!send(input)) {
+            continue;
+        }
+        if (input == "exit") {
+            break;
+        }
+        std::cout << "Данные записаны в разделяемую память.\n";
+    }
+}
+
+int RunRing() {
+    // A segment left behind by a writer that crashed could be attached by a
+    // reader before it is reinitialised, so always start from a fresh one.
+    SharedSegment::Remove(SEGMENT_NAME);
+    SharedSegment segment;
+    if (!segment.Create(SEGMENT_NAME, SpscRing::SegmentSize(RING_CAPACITY))) {
+        return 1;
+    }
 
-int main() {
-    SetConsoleOutputCP(CP_UTF8);
+    SpscRing ring;
+    ring.Init(segment.data(), RING_CAPACITY);
 
-    std::cout << "Программа для записи данных в разделяемую память.\n";
+    Wakeup readable, writable;
+    if (!readable.Open(ring.readable(), std::string(SEGMENT_NAME) + ".readable") ||
+        !writable.Open(ring.writable(), std::string(SEGMENT_NAME) + ".writable")) {
+        return 1;
+    }
 
-    HANDLE hMapFile = CreateFileMappingW(
-            INVALID_HANDLE_VALUE,
-            NULL,
-            PAGE_READWRITE,
-            0,
-            BUF_SIZE,
-            L"Local\\MySharedMemory1"
-    );
-
-    if (hMapFile == NULL) {
-        std::cerr << "Не удалось создать разделяемую память: " << GetLastError() << std::endl;
+    PromptLoop([&](const std::string &input) {
+        if (input.size() > ring.maxMessage()) {
+            std::cerr << "Сообщение слишком длинное: не более " << ring.maxMessage() << " байт." << std::endl;
+            return false;
+        }
+        WriteMessage(ring, readable, writable, input);
+        return true;
+    });
+
+    segment.Close();
+    SharedSegment::Remove(SEGMENT_NAME);
+    return 0;
+}
+
+int RunLog() {
+    MessageLog log;
+    if (!log.Create(SEGMENT_NAME)) {
         return 1;
     }
 
-    LPCTSTR pBuf = (LPTSTR)MapViewOfFile(
-            hMapFile,
-            FILE_MAP_ALL_ACCESS,
-            0,
-            0,
-            BUF_SIZE
-    );
-
-    if (pBuf == NULL) {
-        std::cerr << "Не удалось отобразить разделяемую память: " << GetLastError() << std::endl;
-        CloseHandle(hMapFile);
+    Wakeup appended;
+    if (!appended.Open(log.appended(), std::string(SEGMENT_NAME) + ".appended")) {
         return 1;
     }
 
-    HANDLE hMutex = CreateMutexW(
-            NULL,
-            FALSE,
-            L"Local\\Mutex12"
-    );
+    PromptLoop([&](const std::string &input) {
+        if (!log.Append(input.data(), input.size())) {
+            std::cerr << "Не удалось дописать сообщение в журнал." << std::endl;
+            return false;
+        }
+        appended.Notify();
+        return true;
+    });
+
+    // The log is left in place so that slower readers can finish it; the
+    // next writer removes it on start.
+    return 0;
+}
 
-    if (hMutex == NULL) {
-        std::cerr << "Не удалось создать мьютекс: " << GetLastError() << std::endl;
-        UnmapViewOfFile(pBuf);
-        CloseHandle(hMapFile);
+int RunBroadcast(OverflowPolicy policy) {
+    SharedSegment::Remove(SEGMENT_NAME);
+    SharedSegment segment;
+    if (!segment.Create(SEGMENT_NAME, BroadcastRing::SegmentSize(RING_CAPACITY))) {
         return 1;
     }
 
-    while (true) {
-        std::cout << "Ожидание ввода сообщения...\n";
-        WaitForSingleObject(hMutex, INFINITE);
+    BroadcastRing ring;
+    ring.Init(segment.data(), RING_CAPACITY, policy);
 
-        std::cout << "Введите сообщение для записи в разделяемую память (введите 'exit' для выхода): ";
-        std::string input;
-        std::getline(std::cin, input);
+    Wakeup readable, writable;
+    if (!readable.Open(ring.readable(), std::string(SEGMENT_NAME) + ".readable") ||
+        !writable.Open(ring.writable(), std::string(SEGMENT_NAME) + ".writable")) {
+        return 1;
+    }
 
-        if (input == "exit") {
-            CopyMemory((PVOID)pBuf, "exit", 5 * sizeof(char));
-            break;
+    PromptLoop([&](const std::string &input) {
+        if (input.size() > ring.maxMessage()) {
+            std::cerr << "Сообщение слишком длинное: не более " << ring.maxMessage() << " байт." << std::endl;
+            return false;
         }
-
-        std::string currentData = (char*)pBuf;
-        if (!currentData.empty()) {
-            currentData += "\n";
+        // A reader that dies never notifies writable; waking up now and then
+        // lets TryWrite free its slot.
+        while (!writable.Wait([&] { return ring.TryWrite(input.data(), input.size()); }, REAP_INTERVAL_MS)) {
         }
-        currentData += input;
-        CopyMemory((PVOID)pBuf, currentData.c_str(), (currentData.size() + 1) * sizeof(char));
-        std::cout << "Данные записаны в разделяемую память.\n";
+        readable.Notify();
+        std::cout << "Подключено читателей: " << ring.readerCount() << ".\n";
+        return true;
+    });
 
-        ReleaseMutex(hMutex);
-    }
+    segment.Close();
+    SharedSegment::Remove(SEGMENT_NAME);
+    return 0;
+}
+
+// Usage: writer [ring|log|broadcast [block|drop|detach]]. ring (the default)
+// hands messages to a single reader; log keeps every message for any number
+// of readers; broadcast sends each message to every reader attached at the
+// time, and the policy says what to do about a reader that falls a whole
+// ring behind: wait for it (block, the default), overwrite what it has not
+// read (drop) or detach it (detach).
+int main(int argc, char *argv[]) {
+#ifdef _WIN32
+    SetConsoleOutputCP(CP_UTF8);
+#endif
 
-    UnmapViewOfFile(pBuf);
-    CloseHandle(hMapFile);
-    CloseHandle(hMutex);
+    std::cout << "Программа для записи данных в разделяемую память.\n";
 
-    return 0;
-}
\ No newline at end of file
+    std::string transport = argc > 1 ? argv[1] : "ring";
+    if (transport == "log") {
+        return RunLog();
+    }
+    if (transport == "broadcast") {
+        std::string policy = argc > 2 ? argv[2] : "block";
+        if (policy == "block") return RunBroadcast(OverflowPolicy::Block);
+        if (policy == "drop") return RunBroadcast(OverflowPolicy::DropOldest);
+        if (policy == "detach") return RunBroadcast(OverflowPolicy::DetachLaggard);
+        std::cerr << "Неизвестная политика: " << policy << " (ожидается block, drop или detach)." << std::endl;
+        return 1;
+    }
+    if (transport != "ring") {
+        std::cerr << "Неизвестный режим: " << transport << " (ожидается ring, log или broadcast)." << std::endl;
+        return 1;
+    }
+    return RunRing();
+}
@@ -0,0 +1,75 @@
+#ifndef LAB4_BENCH_OPTIONS_H
+#define LAB4_BENCH_OPTIONS_H
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "record_store.h"
+
+// Command-line parsing shared by the Lab4 benches.
+
+inline const char *modeName(LockMode mode) {
+    return mode == LockMode::Global ? "global" : "striped";
+}
+
+inline std::vector<std::string> splitList(const std::string &value) {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// A comma-separated list of positive whole numbers, e.g. thread counts.
+inline bool parseCounts(const std::string &value, std::vector<size_t> &counts) {
+    counts.clear();
+    for (const auto &item : splitList(value)) {
+        char *end = nullptr;
+        size_t count = std::strtoull(item.c_str(), &end, 10);
+        if (count == 0 || *end != '\0') return false;
+        counts.push_back(count);
+    }
+    return !counts.empty();
+}
+
+// A comma-separated list of lock modes: global, striped.
+inline bool parseModes(const std::string &value, std::vector<LockMode> &modes) {
+    modes.clear();
+    for (const auto &item : splitList(value)) {
+        if (item == "global") {
+            modes.push_back(LockMode::Global);
+        } else if (item == "striped") {
+            modes.push_back(LockMode::Striped);
+        } else {
+            return false;
+        }
+    }
+    return !modes.empty();
+}
+
+// Calls option(name, value) for every --name=value or --name value pair;
+// false if an option has no value or option rejects one.
+template <typename Option>
+bool forEachOption(int argc, char *argv[], Option option) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string name = arg;
+        std::string value;
+        size_t equals = arg.find('=');
+        if (equals != std::string::npos) {
+            name = arg.substr(0, equals);
+            value = arg.substr(equals + 1);
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        } else {
+            return false;
+        }
+        if (!option(name, value)) return false;
+    }
+    return true;
+}
+
+#endif //LAB4_BENCH_OPTIONS_H
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench_options.h"
+#include "record_layout.h"
+#include "record_store.h"
+
+// Contention benchmark: a mix of reads and writes on random slots from 1 to
+// 64 threads, with the global lock and with striped seqlocks. Reports the
+// median throughput of several repetitions and the speedup over one thread.
+
+const char *const NAMES[] = {"Writer", "Reader", "Object", "Record"};
+
+struct BenchOptions {
+    std::vector<size_t> threads = {1, 2, 4, 8, 16, 32, 64};
+    std::vector<LockMode> modes = {LockMode::Global, LockMode::Striped};
+    size_t records = 1024;
+    size_t operations = 4'000'000;
+    unsigned readPercent = 90;
+    size_t repetitions = 5;
+    std::string csvPath;
+};
+
+struct BenchResult {
+    std::string mode;
+    size_t threads;
+    double medianSeconds;
+    double operationsPerSecond;
+    double speedup;
+    double retriesPerRead;
+};
+
+bool parseOptions(int argc, char *argv[], BenchOptions &options) {
+    bool parsed = forEachOption(argc, argv, [&](const std::string &name, const std::string &value) {
+        if (name == "--threads") return parseCounts(value, options.threads);
+        if (name == "--modes") return parseModes(value, options.modes);
+        if (name == "--records") {
+            options.records = std::strtoull(value.c_str(), nullptr, 10);
+            return options.records != 0;
+        }
+        if (name == "--operations") {
+            options.operations = static_cast<size_t>(std::strtod(value.c_str(), nullptr));
+            return options.operations != 0;
+        }
+        if (name == "--read-percent") {
+            options.readPercent = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+            return options.readPercent <= 100;
+        }
+        if (name == "--repetitions") {
+            options.repetitions = std::strtoull(value.c_str(), nullptr, 10);
+            return options.repetitions != 0;
+        }
+        if (name == "--csv") {
+            options.csvPath = value;
+            return true;
+        }
+        return false;
+    });
+    if (!parsed) return false;
+
+    if (std::find(options.threads.begin(), options.threads.end(), 1) == options.threads.end()) {
+        options.threads.push_back(1);
+    }
+    std::sort(options.threads.begin(), options.threads.end());
+    return true;
+}
+
+// Runs operations split across numThreads threads; returns the elapsed
+// seconds and adds the optimistic read retries to retries.
+double runOnce(RecordStore &store, const BenchOptions &options, size_t numThreads, unsigned long long &retries,
+               unsigned long long &reads) {
+    std::vector<std::thread> threads;
+    std::vector<unsigned> threadRetries(numThreads);
+    std::vector<size_t> threadReads(numThreads);
+    std::vector<char> failed(numThreads);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&, t] {
+            std::mt19937 rng(static_cast<unsigned>(t + 1));
+            size_t share = options.operations / numThreads + (t < options.operations % numThreads);
+            unsigned localRetries = 0;
+            size_t localReads = 0;
+            for (size_t i = 0; i < share; ++i) {
+                int index = static_cast<int>(rng() % options.records);
+                if (rng() % 100 < options.readPercent) {
+                    Record record = store.Read(index, &localRetries);
+                    // A torn read would pair an id with another write's name.
+                    if (record.id != 0 && strcmp(store.Name(record), NAMES[record.id % 4]) != 0) {
+                        failed[t] = true;
+                    }
+                    ++localReads;
+                } else {
+                    int id = static_cast<int>(rng() % 1000) + 1;
+                    store.Write(index, id, NAMES[id % 4]);
+                }
+            }
+            threadRetries[t] = localRetries;
+            threadReads[t] = localReads;
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    auto end = std::chrono::steady_clock::now();
+
+    for (size_t t = 0; t < numThreads; ++t) {
+        if (failed[t]) {
+            std::cerr << "Inconsistent read in " << modeName(store.mode()) << " mode\n";
+            std::exit(1);
+        }
+        retries += threadRetries[t];
+        reads += threadReads[t];
+    }
+    return std::chrono::duration<double>(end - start).count();
+}
+
+void writeCsv(std::ostream &out, const std::vector<BenchResult> &results) {
+    out << "mode,threads,median_seconds,operations_per_second,speedup,retries_per_read\n";
+    for (const auto &result : results) {
+        out << result.mode << ',' << result.threads << ',' << result.medianSeconds << ','
+            << result.operationsPerSecond << ',' << result.speedup << ',' << result.retriesPerRead << '\n';
+    }
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--threads N,...] [--modes global,striped] [--records N]"
+                  << " [--operations N] [--read-percent P] [--repetitions N] [--csv FILE]\n";
+        return 1;
+    }
+
+    const uint32_t arenaSize = 4096;
+    std::vector<char> view(RecordLayout::ViewSize(static_cast<uint32_t>(options.records), arenaSize));
+    std::vector<BenchResult> results;
+
+    for (LockMode mode : options.modes) {
+        double singleThreadSeconds = 0;
+        for (size_t numThreads : options.threads) {
+            std::fill(view.begin(), view.end(), 0);
+            RecordLayout layout;
+            layout.Attach(view.data(), static_cast<uint32_t>(options.records), arenaSize);
+            RecordStore store(layout, mode);
+
+            std::vector<double> seconds;
+            unsigned long long retries = 0;
+            unsigned long long reads = 0;
+            // The first run is a warmup.
+            for (size_t run = 0; run <= options.repetitions; ++run) {
+                double elapsed = runOnce(store, options, numThreads, retries, reads);
+                if (run > 0) seconds.push_back(elapsed);
+            }
+
+            std::sort(seconds.begin(), seconds.end());
+            BenchResult result{};
+            result.mode = modeName(mode);
+            result.threads = numThreads;
+            result.medianSeconds = seconds[seconds.size() / 2];
+            result.operationsPerSecond = options.operations / result.medianSeconds;
+            if (numThreads == 1) singleThreadSeconds = result.medianSeconds;
+            result.speedup = singleThreadSeconds / result.medianSeconds;
+            result.retriesPerRead = reads ? static_cast<double>(retries) / reads : 0;
+
+            std::cerr << result.mode << " t=" << numThreads << ": " << result.operationsPerSecond / 1e6
+                      << " M ops/s, speedup " << result.speedup << ", retries/read " << result.retriesPerRead << "\n";
+            results.push_back(result);
+        }
+    }
+
+    if (options.csvPath.empty()) {
+        writeCsv(std::cout, results);
+    } else {
+        std::ofstream csv(options.csvPath);
+        writeCsv(csv, results);
+        if (!csv) {
+            std::cerr << "Failed to write " << options.csvPath << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -1,148 +1,196 @@
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include <cerrno>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
+#include "record_layout.h"
+#include "record_store.h"
+#include "worker_pool.h"
 
-struct Record {
-    int id;
-    char name[50];
-};
-
-std::vector<bool> dataReady;
-SRWLOCK srwLock;
-HANDLE hCoutMutex;
+RecordLayout layout;
+std::mutex coutMutex;
 
-struct WriteParams {
-    LPVOID mappedView;
-    int index;
-    int id;
-    const char* name;
-};
-
-struct ReadParams {
-    LPVOID mappedView;
-    int index;
+struct MappedView {
+#ifdef _WIN32
+    HANDLE hFile;
+    HANDLE hMapFile;
+#else
+    int fd;
+#endif
+    void* data;
+    size_t size;
 };
 
-HANDLE CreateAndMapFile(LPCSTR filename, DWORD size, HANDLE &hFile, LPVOID &mappedView) {
-    hFile = CreateFile(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+#ifdef _WIN32
+bool CreateAndMapFile(const char* filename, size_t size, MappedView &view) {
+    HANDLE hFile = CreateFile(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
     if (hFile == INVALID_HANDLE_VALUE) {
         std::cerr << "Failed to create file" << std::endl;
-        return NULL;
+        return false;
     }
 
-    if (SetFilePointer(hFile, size, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER && GetLastError() != NO_ERROR) {
+    if (SetFilePointer(hFile, static_cast<LONG>(size), NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER && GetLastError() != NO_ERROR) {
         std::cerr << "Failed to set file pointer with error: " << GetLastError() << std::endl;
         CloseHandle(hFile);
-        return NULL;
+        return false;
     }
     if (!SetEndOfFile(hFile)) {
         std::cerr << "Failed to set end of file with error: " << GetLastError() << std::endl;
         CloseHandle(hFile);
-        return NULL;
+        return false;
     }
 
-    HANDLE hMapFile = CreateFileMapping(hFile, NULL, PAGE_READWRITE, 0, size, NULL);
+    HANDLE hMapFile = CreateFileMapping(hFile, NULL, PAGE_READWRITE, 0, static_cast<DWORD>(size), NULL);
     if (!hMapFile) {
         std::cerr << "Failed to create file mapping" << std::endl;
         CloseHandle(hFile);
-        return NULL;
+        return false;
     }
 
-    mappedView = MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    void* mappedView = MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, size);
     if (!mappedView) {
         std::cerr << "Failed to map file view" << std::endl;
         CloseHandle(hMapFile);
         CloseHandle(hFile);
-        return NULL;
+        return false;
     }
 
-    return hMapFile;
+    view = {hFile, hMapFile, mappedView, size};
+    return true;
 }
 
-DWORD WINAPI WriteRecord(LPVOID params) {
-    auto* wp = static_cast<WriteParams*>(params);
-
-    AcquireSRWLockExclusive(&srwLock);
-
-    Record* records = static_cast<Record*>(wp->mappedView);
-    records[wp->index].id = wp->id;
-    strncpy(records[wp->index].name, wp->name, sizeof(records[wp->index].name) - 1);
-    records[wp->index].name[sizeof(records[wp->index].name) - 1] = '\0';
-
-    dataReady[wp->index] = true;
-
-    ReleaseSRWLockExclusive(&srwLock);
-
-    WaitForSingleObject(hCoutMutex, INFINITE);
-    std::cout << "Writer Thread - Written Record #" << wp->index + 1 << ": ID = " << wp->id << ", Name = " << wp->name << std::endl;
-    ReleaseMutex(hCoutMutex);
-
-    delete wp;
-    return 0;
+void UnmapAndCloseFile(MappedView &view) {
+    UnmapViewOfFile(view.data);
+    CloseHandle(view.hMapFile);
+    CloseHandle(view.hFile);
 }
+#else
+bool CreateAndMapFile(const char* filename, size_t size, MappedView &view) {
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        std::cerr << "Failed to create file" << std::endl;
+        return false;
+    }
 
-DWORD WINAPI ReadRecord(LPVOID params) {
-    auto* rp = static_cast<ReadParams*>(params);
-
-    if (dataReady[rp->index]) {
-        AcquireSRWLockShared(&srwLock);
+    if (ftruncate(fd, static_cast<off_t>(size)) == -1) {
+        std::cerr << "Failed to set end of file with error: " << errno << std::endl;
+        close(fd);
+        return false;
+    }
 
-        Record* records = static_cast<Record*>(rp->mappedView);
+    void* mappedView = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mappedView == MAP_FAILED) {
+        std::cerr << "Failed to map file view" << std::endl;
+        close(fd);
+        return false;
+    }
 
-        WaitForSingleObject(hCoutMutex, INFINITE);
-        std::cout << "Reader Thread - Read Record #" << rp->index + 1 << ": ID = " << records[rp->index].id << ", Name = " << records[rp->index].name << std::endl;
-        ReleaseMutex(hCoutMutex);
+    view = {fd, mappedView, size};
+    return true;
+}
 
-        ReleaseSRWLockShared(&srwLock);
+void UnmapAndCloseFile(MappedView &view) {
+    munmap(view.data, view.size);
+    close(view.fd);
+}
+#endif
+
+// Runs on a pool worker once an operation has been executed.
+void ReportOperation(const Operation &operation, void*) {
+    std::lock_guard<std::mutex> lock(coutMutex);
+    if (operation.kind == OperationKind::Write) {
+        if (operation.written) {
+            std::cout << "Writer Thread - Written Record #" << operation.index + 1 << ": ID = " << operation.id << ", Name = " << operation.name << std::endl;
+        } else {
+            std::cerr << "Writer Thread - No room for the name of record #" << operation.index + 1 << std::endl;
+        }
+    } else if (operation.written) {
+        std::cout << "Reader Thread - Read Record #" << operation.index + 1 << ": ID = " << operation.record.id << ", Name = " << layout.Name(operation.record) << std::endl;
     } else {
-        WaitForSingleObject(hCoutMutex, INFINITE);
-        std::cout << "Reader Thread - Record #" << rp->index + 1 << " is not yet written, skipping." << std::endl;
-        ReleaseMutex(hCoutMutex);
+        std::cout << "Reader Thread - Record #" << operation.index + 1 << " is not yet written, skipping." << std::endl;
     }
-
-    delete rp;
-    return 0;
 }
 
-int main() {
-    LPVOID mappedView;
-    HANDLE hFile;
-    int maxRecords = 10;
-    const DWORD initialSize = sizeof(Record) * maxRecords;
-
-    InitializeSRWLock(&srwLock);
-    hCoutMutex = CreateMutex(NULL, FALSE, NULL);
-
-    HANDLE hMapFile = CreateAndMapFile("database2.bin", initialSize, hFile, mappedView);
-
-    if (hMapFile) {
-        dataReady.resize(maxRecords, false);
-
-        HANDLE threads[10];
-
-        for (int i = 0; i < 5; i++) {
-            auto* params = new WriteParams{mappedView, i, i, "Writer"};
-            threads[i] = CreateThread(NULL, 0, WriteRecord, params, 0, NULL);
-        }
+// Blocks until record index is published by a writer, instead of skipping it.
+void ReadRecord(const RecordStore &store, int index, unsigned timeoutMs) {
+    Record record;
+    bool written = store.ReadWhenWritten(index, timeoutMs, record);
 
-        for (int i = 0; i < 5; i++) {
-            auto* params = new ReadParams{mappedView, i};
-            threads[i + 5] = CreateThread(NULL, 0, ReadRecord, params, 0, NULL);
-        }
+    std::lock_guard<std::mutex> lock(coutMutex);
+    if (written) {
+        std::cout << "Reader Thread - Read Record #" << index + 1 << ": ID = " << record.id << ", Name = " << store.Name(record) << std::endl;
+    } else {
+        std::cout << "Reader Thread - Record #" << index + 1 << " was not written within " << timeoutMs << " ms." << std::endl;
+    }
+}
 
-        WaitForMultipleObjects(10, threads, TRUE, INFINITE);
+int main(int argc, char* argv[]) {
+    LockMode mode = LockMode::Striped;
+    if (argc > 1 && strcmp(argv[1], "global") == 0) {
+        mode = LockMode::Global;
+    } else if (argc > 1 && strcmp(argv[1], "striped") != 0) {
+        std::cerr << "Usage: " << argv[0] << " [global|striped]" << std::endl;
+        return 1;
+    }
 
-        for (auto& thread : threads) {
-            CloseHandle(thread);
+    int maxRecords = 10;
+    const uint32_t arenaSize = 4096;
+    MappedView view;
+
+    if (CreateAndMapFile("database2.bin", RecordLayout::ViewSize(maxRecords, arenaSize), view)) {
+        // The file is recreated on every run, so there is no old layout to migrate.
+        layout.Attach(view.data, maxRecords, arenaSize);
+        // The store is destroyed before the view it points into is unmapped.
+        {
+            RecordStore store(layout, mode, true);
+
+            // Readers start first and wait for their records to be published.
+            std::vector<std::thread> readers;
+            for (int i = 0; i < 5; i++) {
+                readers.emplace_back(ReadRecord, std::cref(store), i, 1000);
+            }
+
+            {
+                WorkerPool pool(store, 4, 64, ReportOperation, nullptr);
+
+                for (int i = 0; i < 5; i++) {
+                    pool.Submit({OperationKind::Write, i, i, "Writer", {}, false});
+                }
+
+                pool.WaitIdle();
+
+                // The snapshot keeps showing the records as written above while
+                // they are overwritten.
+                RecordStore::Snapshot snapshot = store.OpenSnapshot();
+                for (int i = 0; i < 5; i++) {
+                    pool.Submit({OperationKind::Write, i, i + 100, "Updated", {}, false});
+                }
+                pool.WaitIdle();
+
+                std::lock_guard<std::mutex> lock(coutMutex);
+                snapshot.ForEach([&](int index, const Record &record) {
+                    Record current = store.Read(index);
+                    std::cout << "Snapshot Reader - Record #" << index + 1 << ": ID = " << record.id << ", Name = " << store.Name(record)
+                              << " (now ID = " << current.id << ", Name = " << store.Name(current) << ")" << std::endl;
+                });
+            }
+
+            for (auto& reader : readers) {
+                reader.join();
+            }
         }
 
-        UnmapViewOfFile(mappedView);
-        CloseHandle(hMapFile);
-        CloseHandle(hFile);
+        UnmapAndCloseFile(view);
     }
 
-    CloseHandle(hCoutMutex);
-
     return 0;
 }
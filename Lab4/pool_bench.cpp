@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench_options.h"
+#include "record_layout.h"
+#include "record_store.h"
+#include "worker_pool.h"
+
+// Throughput benchmark for the worker pool: operations per second with one
+// thread created per operation, as Lab4 used to run, and with a persistent
+// WorkerPool, for several worker counts and both lock modes.
+
+const char *const NAMES[] = {"Writer", "Reader", "Object", "Record"};
+
+struct BenchOptions {
+    std::vector<size_t> workers = {1, 2, 4, 8};
+    std::vector<LockMode> modes = {LockMode::Global, LockMode::Striped};
+    size_t records = 1024;
+    size_t operations = 2'000'000;
+    // Spawning a thread per operation is slow enough to need its own count.
+    size_t threadPerOperationCount = 20'000;
+    unsigned readPercent = 90;
+    std::string csvPath;
+};
+
+struct BenchResult {
+    std::string approach;
+    std::string mode;
+    size_t workers;
+    size_t operations;
+    double seconds;
+    double operationsPerSecond;
+};
+
+bool parseOptions(int argc, char *argv[], BenchOptions &options) {
+    return forEachOption(argc, argv, [&](const std::string &name, const std::string &value) {
+        if (name == "--workers") return parseCounts(value, options.workers);
+        if (name == "--modes") return parseModes(value, options.modes);
+        if (name == "--records") {
+            options.records = std::strtoull(value.c_str(), nullptr, 10);
+            return options.records != 0;
+        }
+        if (name == "--operations") {
+            options.operations = static_cast<size_t>(std::strtod(value.c_str(), nullptr));
+            return options.operations != 0;
+        }
+        if (name == "--thread-per-operation") {
+            options.threadPerOperationCount = static_cast<size_t>(std::strtod(value.c_str(), nullptr));
+            return true;
+        }
+        if (name == "--read-percent") {
+            options.readPercent = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+            return options.readPercent <= 100;
+        }
+        if (name == "--csv") {
+            options.csvPath = value;
+            return true;
+        }
+        return false;
+    });
+}
+
+std::vector<Operation> generate(const BenchOptions &options, size_t count) {
+    std::mt19937 rng(42);
+    std::vector<Operation> operations(count);
+    for (auto &operation : operations) {
+        int index = static_cast<int>(rng() % options.records);
+        if (rng() % 100 < options.readPercent) {
+            operation = {OperationKind::Read, index, 0, nullptr, {}, false};
+        } else {
+            int id = static_cast<int>(rng() % 1000) + 1;
+            operation = {OperationKind::Write, index, id, NAMES[id % 4], {}, false};
+        }
+    }
+    return operations;
+}
+
+double runThreadPerOperation(RecordStore &store, std::vector<Operation> &operations) {
+    auto start = std::chrono::steady_clock::now();
+    for (auto &operation : operations) {
+        std::thread([&store, &operation] { store.Execute(&operation, 1); }).join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double runPool(RecordStore &store, size_t workers, const std::vector<Operation> &operations) {
+    WorkerPool pool(store, workers);
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &operation : operations) pool.Submit(operation);
+    pool.WaitIdle();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void writeCsv(std::ostream &out, const std::vector<BenchResult> &results) {
+    out << "approach,mode,workers,operations,seconds,operations_per_second\n";
+    for (const auto &result : results) {
+        out << result.approach << ',' << result.mode << ',' << result.workers << ',' << result.operations << ','
+            << result.seconds << ',' << result.operationsPerSecond << '\n';
+    }
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--workers N,...] [--modes global,striped] [--records N]"
+                  << " [--operations N] [--thread-per-operation N] [--read-percent P] [--csv FILE]\n";
+        return 1;
+    }
+
+    const uint32_t arenaSize = 4096;
+    std::vector<char> view(RecordLayout::ViewSize(static_cast<uint32_t>(options.records), arenaSize));
+    std::vector<BenchResult> results;
+
+    auto record = [&](const char *approach, LockMode mode, size_t workers, size_t count, double seconds) {
+        BenchResult result{approach, modeName(mode), workers, count, seconds, count / seconds};
+        std::cerr << approach << " " << result.mode << " workers=" << workers << ": "
+                  << result.operationsPerSecond / 1e6 << " M ops/s\n";
+        results.push_back(result);
+    };
+
+    for (LockMode mode : options.modes) {
+        if (options.threadPerOperationCount > 0) {
+            std::fill(view.begin(), view.end(), 0);
+            RecordLayout layout;
+            layout.Attach(view.data(), static_cast<uint32_t>(options.records), arenaSize);
+            RecordStore store(layout, mode);
+            std::vector<Operation> operations = generate(options, options.threadPerOperationCount);
+            record("thread-per-operation", mode, 1, operations.size(), runThreadPerOperation(store, operations));
+        }
+
+        std::vector<Operation> operations = generate(options, options.operations);
+        for (size_t workers : options.workers) {
+            std::fill(view.begin(), view.end(), 0);
+            RecordLayout layout;
+            layout.Attach(view.data(), static_cast<uint32_t>(options.records), arenaSize);
+            RecordStore store(layout, mode);
+            record("pool", mode, workers, operations.size(), runPool(store, workers, operations));
+        }
+    }
+
+    if (options.csvPath.empty()) {
+        writeCsv(std::cout, results);
+    } else {
+        std::ofstream csv(options.csvPath);
+        writeCsv(csv, results);
+        if (!csv) {
+            std::cerr << "Failed to write " << options.csvPath << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+#ifndef LAB4_RECORD_LAYOUT_H
+#define LAB4_RECORD_LAYOUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+// Fixed-size slot: id plus the offset of the name in the arena.
+struct Record {
+    int32_t id;
+    uint32_t name;
+};
+
+// Layout of the mapped view: a header, maxRecords slots and a string arena
+// of arenaSize bytes. Names are stored once as NUL-terminated strings; with
+// dictionary encoding a name already in the arena is reused. Offset 0 of the
+// arena always holds "", so a zeroed slot reads as an empty record.
+//
+// The layout itself is not synchronised; RecordStore serialises Intern and
+// the slot writes. The arena is append-only and a name is complete before
+// any slot refers to it, so a reader holding a slot can follow its name
+// offset without further synchronisation.
+class RecordLayout {
+public:
+    struct Header {
+        uint32_t magic;
+        uint32_t maxRecords;
+        uint32_t arenaSize;
+        uint32_t arenaUsed;
+    };
+
+    static size_t ViewSize(uint32_t maxRecords, uint32_t arenaSize) {
+        return sizeof(Header) + sizeof(Record) * maxRecords + arenaSize;
+    }
+
+    // Initialises a zeroed view of ViewSize(maxRecords, arenaSize) bytes.
+    void Attach(void *view, uint32_t maxRecords, uint32_t arenaSize, bool useDictionary = true) {
+        this->view = static_cast<char *>(view);
+        this->useDictionary = useDictionary;
+        dictionary.clear();
+        *header() = {MAGIC, maxRecords, arenaSize, 1};
+        arena()[0] = '\0';
+    }
+
+    Record *records() const { return reinterpret_cast<Record *>(view + sizeof(Header)); }
+    const char *Name(const Record &record) const { return arena() + record.name; }
+    uint32_t maxRecords() const { return header()->maxRecords; }
+    uint32_t arenaUsed() const { return header()->arenaUsed; }
+
+    // Writes slot index; false if the arena has no room for the name.
+    bool Write(int index, int id, const char *name) {
+        uint32_t ref = Intern(name);
+        if (ref == NO_NAME) return false;
+        records()[index] = {id, ref};
+        return true;
+    }
+
+    static const uint32_t NO_NAME = UINT32_MAX;
+
+    // Offset of name if the dictionary already holds it, otherwise NO_NAME.
+    // Only reads the dictionary, so concurrent calls are safe while no
+    // Intern runs.
+    uint32_t Find(const char *name) const {
+        if (name[0] == '\0') return 0;
+        if (!useDictionary) return NO_NAME;
+        auto found = dictionary.find(name);
+        return found == dictionary.end() ? NO_NAME : found->second;
+    }
+
+    // Offset of name, appending it to the arena if needed; NO_NAME if the
+    // arena is full.
+    uint32_t Intern(const char *name) {
+        uint32_t found = Find(name);
+        if (found != NO_NAME) return found;
+        size_t length = strlen(name);
+
+        uint32_t ref = header()->arenaUsed;
+        if (length + 1 > header()->arenaSize - ref) return NO_NAME;
+        memcpy(arena() + ref, name, length + 1);
+        header()->arenaUsed = ref + static_cast<uint32_t>(length) + 1;
+        if (useDictionary) dictionary.emplace(name, ref);
+        return ref;
+    }
+
+private:
+    static const uint32_t MAGIC = 0x3442414C; // "LAB4"
+
+    char *view = nullptr;
+    bool useDictionary = true;
+    std::unordered_map<std::string, uint32_t> dictionary;
+
+    Header *header() const { return reinterpret_cast<Header *>(view); }
+    char *arena() const { return view + sizeof(Header) + sizeof(Record) * header()->maxRecords; }
+};
+
+#endif //LAB4_RECORD_LAYOUT_H
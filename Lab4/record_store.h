@@ -0,0 +1,502 @@
+#ifndef LAB4_RECORD_STORE_H
+#define LAB4_RECORD_STORE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "record_layout.h"
+#include "wait_word.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Reader/writer lock: SRWLOCK on Windows, pthread_rwlock_t elsewhere.
+class RwLock {
+public:
+#ifdef _WIN32
+    RwLock() { InitializeSRWLock(&lock); }
+    void LockShared() { AcquireSRWLockShared(&lock); }
+    void UnlockShared() { ReleaseSRWLockShared(&lock); }
+    void Lock() { AcquireSRWLockExclusive(&lock); }
+    void Unlock() { ReleaseSRWLockExclusive(&lock); }
+#else
+    RwLock() { pthread_rwlock_init(&lock, nullptr); }
+    ~RwLock() { pthread_rwlock_destroy(&lock); }
+    void LockShared() { pthread_rwlock_rdlock(&lock); }
+    void UnlockShared() { pthread_rwlock_unlock(&lock); }
+    void Lock() { pthread_rwlock_wrlock(&lock); }
+    void Unlock() { pthread_rwlock_unlock(&lock); }
+#endif
+
+    RwLock(const RwLock &) = delete;
+    RwLock &operator=(const RwLock &) = delete;
+
+private:
+#ifdef _WIN32
+    SRWLOCK lock;
+#else
+    pthread_rwlock_t lock;
+#endif
+};
+
+enum class LockMode {
+    // One reader/writer lock over the whole view.
+    Global,
+    // Writers take one of STRIPES locks chosen by slot; readers take no lock
+    // and validate their copy against the slot's sequence number.
+    Striped
+};
+
+enum class OperationKind {
+    Read,
+    Write
+};
+
+// One request against the store. A read fills record; written tells whether
+// the slot had been written at the time. A write sets written once stored.
+struct Operation {
+    OperationKind kind;
+    int index;
+    int id;
+    const char *name;
+    Record record;
+    bool written;
+};
+
+// Concurrent access to the slots of a RecordLayout.
+//
+// In striped mode every slot has a sequence number that is odd while a write
+// is in progress. A reader copies the slot between two loads of the number
+// and retries if it was odd or changed, so readers never block writers or
+// each other. Writers of slots in different stripes run in parallel; only a
+// name missing from the dictionary briefly takes the arena lock exclusively.
+//
+// A versioned store also keeps, per slot, a copy-on-write chain of versions,
+// newest first, for snapshot reads. Every Execute batch with a write takes
+// the next commit number, stamps its versions with it and is published
+// once all earlier batches are, so a snapshot taken at the published commit
+// sees whole batches only. Open snapshots announce their commit in a table;
+// the oldest announced one is the reclamation horizon (epoch), and a writer
+// frees the versions of the slot it writes that are hidden behind a newer
+// one at or below it.
+class RecordStore {
+public:
+    static const size_t STRIPES = 64;
+    static const size_t MAX_SNAPSHOTS = 64;
+
+    // Read-only view of the store as of the moment it was opened; see
+    // OpenSnapshot.
+    class Snapshot {
+    public:
+        Snapshot(Snapshot &&other) noexcept : store(other.store), slot(other.slot), commit(other.commit) {
+            other.slot = nullptr;
+        }
+        Snapshot(const Snapshot &) = delete;
+        Snapshot &operator=(const Snapshot &) = delete;
+        ~Snapshot() { Close(); }
+
+        // Lets writers reclaim the versions kept for this snapshot.
+        void Close();
+        // Slot index as of the snapshot; false if it had not been written.
+        bool Read(int index, Record &record) const;
+        // Calls visit(index, record) for every slot written as of the snapshot.
+        template <typename Visit>
+        void ForEach(Visit visit) const;
+        uint64_t timestamp() const { return commit; }
+
+    private:
+        friend class RecordStore;
+        Snapshot(const RecordStore &store, std::atomic<uint64_t> *slot, uint64_t commit)
+                : store(&store), slot(slot), commit(commit) {}
+
+        const RecordStore *store;
+        std::atomic<uint64_t> *slot;
+        uint64_t commit;
+    };
+
+    // versioned keeps the versions snapshots need; it costs every write an
+    // allocation.
+    RecordStore(RecordLayout &layout, LockMode mode, bool versioned = false)
+            : layout(layout), lockMode(mode), slotCount(layout.maxRecords()),
+              sequences(new std::atomic<uint32_t>[slotCount]()),
+              versions(versioned ? new std::atomic<Version *>[slotCount]() : nullptr) {}
+    ~RecordStore();
+
+    // False if the arena has no room for the name.
+    bool Write(int index, int id, const char *name);
+    // Consistent copy of slot index. retries, if given, is increased by the
+    // number of optimistic reads that had to be repeated.
+    Record Read(int index, unsigned *retries = nullptr) const;
+    // Blocking read for producer/consumer handoff: waits until slot index
+    // has been written at least once, then copies it into record. Sleeps on
+    // the slot's sequence word and wakes when the write is published. False
+    // if timeoutMs passes first.
+    bool ReadWhenWritten(int index, unsigned timeoutMs, Record &record) const;
+    // Runs a batch of operations, taking each lock once for the whole batch
+    // rather than once per operation: the global lock in global mode, the
+    // stripes with writes in striped mode. Operations on the same slot take
+    // effect in batch order. A write's record is set to the stored slot.
+    void Execute(Operation *operations, size_t count);
+    // The name of a record returned by Read; arena entries never change.
+    const char *Name(const Record &record) const { return layout.Name(record); }
+
+    // Opens a consistent view of every slot for a versioned store: all
+    // batches published so far and none after. Reading it takes no lock and
+    // never blocks writers, however long it stays open. Waits while
+    // MAX_SNAPSHOTS are already open.
+    Snapshot OpenSnapshot() const;
+
+    LockMode mode() const { return lockMode; }
+    bool versioned() const { return versions != nullptr; }
+
+private:
+    // Own cache line per stripe, so writers in different stripes do not
+    // contend on the lock words. Stripes are only ever locked exclusively,
+    // and a plain mutex is far cheaper than a write-locked rwlock when
+    // writers queue up on one.
+    struct alignas(64) Stripe {
+        std::mutex lock;
+    };
+
+    RecordLayout &layout;
+    LockMode lockMode;
+    // Copied so that the destructor does not read the view, which may be
+    // unmapped by then.
+    uint32_t slotCount;
+    mutable RwLock globalLock;
+    Stripe stripes[STRIPES];
+    RwLock arenaLock;
+    // Twice the number of completed writes of each slot; odd while a
+    // striped write is in progress. Also the word readers block on.
+    std::unique_ptr<std::atomic<uint32_t>[]> sequences;
+    // Threads in ReadWhenWritten. Writers only make the wake system call
+    // while this is nonzero.
+    alignas(64) mutable std::atomic<uint32_t> waiters{0};
+
+    // Immutable once linked, apart from older, which a writer holding the
+    // slot's lock cuts when reclaiming.
+    struct Version {
+        int32_t id;
+        uint32_t name;
+        uint64_t commit;
+        std::atomic<Version *> older;
+    };
+
+    static const uint64_t NO_SNAPSHOT = UINT64_MAX;
+
+    struct alignas(64) SnapshotSlot {
+        std::atomic<uint64_t> commit{NO_SNAPSHOT};
+    };
+
+    // Newest version of each slot; null for a store that is not versioned.
+    std::unique_ptr<std::atomic<Version *>[]> versions;
+    mutable SnapshotSlot snapshots[MAX_SNAPSHOTS];
+    // Last commit number handed out, and the last one whose batch and every
+    // batch before it are complete.
+    alignas(64) std::atomic<uint64_t> lastCommit{0};
+    alignas(64) std::atomic<uint64_t> published{0};
+    // No open or future snapshot reads below this commit.
+    alignas(64) std::atomic<uint64_t> horizon{0};
+
+    // Slot fields are accessed as relaxed atomics in striped mode, so a
+    // reader overlapping a write gets a stale value rather than a data race.
+    template <typename T>
+    static std::atomic<T> &Field(T &field) {
+        static_assert(sizeof(std::atomic<T>) == sizeof(T), "atomic field must match the slot layout");
+        return reinterpret_cast<std::atomic<T> &>(field);
+    }
+
+    static size_t StripeOf(int index) { return static_cast<size_t>(index) % STRIPES; }
+
+    uint32_t InternName(const char *name);
+    // Store and Load need the lock guarding index: the global lock or its
+    // stripe. commit is 0 for a store that is not versioned.
+    void Store(int index, int id, uint32_t ref, uint64_t commit);
+    Record Load(int index, bool &written) const;
+    Record ReadOptimistic(int index, unsigned *retries, bool &written) const;
+    void ExecuteStriped(Operation *operations, size_t count, uint64_t commit);
+
+    void AddVersion(int index, int id, uint32_t ref, uint64_t commit);
+    // Waits for the batches before commit, then publishes it.
+    void Publish(uint64_t commit);
+    void UpdateHorizon();
+};
+
+inline RecordStore::~RecordStore() {
+    if (!versions) return;
+    for (uint32_t index = 0; index < slotCount; ++index) {
+        for (Version *version = versions[index].load(std::memory_order_relaxed); version;) {
+            Version *older = version->older.load(std::memory_order_relaxed);
+            delete version;
+            version = older;
+        }
+    }
+}
+
+inline uint32_t RecordStore::InternName(const char *name) {
+    arenaLock.LockShared();
+    uint32_t ref = layout.Find(name);
+    arenaLock.UnlockShared();
+    if (ref != RecordLayout::NO_NAME) return ref;
+
+    arenaLock.Lock();
+    ref = layout.Intern(name);
+    arenaLock.Unlock();
+    return ref;
+}
+
+inline void RecordStore::Store(int index, int id, uint32_t ref, uint64_t commit) {
+    if (versions) AddVersion(index, id, ref, commit);
+
+    std::atomic<uint32_t> &sequence = sequences[index];
+    uint32_t version = sequence.load(std::memory_order_relaxed);
+    sequence.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Record &record = layout.records()[index];
+    Field(record.id).store(id, std::memory_order_relaxed);
+    Field(record.name).store(ref, std::memory_order_relaxed);
+
+    sequence.store(version + 2, std::memory_order_release);
+    // Pairs with the fence in ReadWhenWritten: either the waiter sees the
+    // new sequence before sleeping or this thread sees the waiter.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) != 0) WakeWord(sequence);
+}
+
+inline Record RecordStore::Load(int index, bool &written) const {
+    Record &record = layout.records()[index];
+    written = sequences[index].load(std::memory_order_relaxed) != 0;
+    return {Field(record.id).load(std::memory_order_relaxed), Field(record.name).load(std::memory_order_relaxed)};
+}
+
+inline Record RecordStore::ReadOptimistic(int index, unsigned *retries, bool &written) const {
+    Record &record = layout.records()[index];
+    const std::atomic<uint32_t> &sequence = sequences[index];
+    for (unsigned attempt = 0;; ++attempt) {
+        uint32_t before = sequence.load(std::memory_order_acquire);
+        if ((before & 1) == 0) {
+            Record copy{Field(record.id).load(std::memory_order_relaxed),
+                        Field(record.name).load(std::memory_order_relaxed)};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                if (retries) *retries += attempt;
+                written = before != 0;
+                return copy;
+            }
+        }
+        // Writes hold a slot for a few stores; yield only if one is stuck,
+        // e.g. preempted while holding it.
+        if (attempt % 64 == 63) std::this_thread::yield();
+    }
+}
+
+inline bool RecordStore::Write(int index, int id, const char *name) {
+    Operation operation{OperationKind::Write, index, id, name, {}, false};
+    Execute(&operation, 1);
+    return operation.written;
+}
+
+inline Record RecordStore::Read(int index, unsigned *retries) const {
+    bool written;
+    if (lockMode == LockMode::Striped) return ReadOptimistic(index, retries, written);
+
+    globalLock.LockShared();
+    Record copy = Load(index, written);
+    globalLock.UnlockShared();
+    return copy;
+}
+
+inline bool RecordStore::ReadWhenWritten(int index, unsigned timeoutMs, Record &record) const {
+    const std::atomic<uint32_t> &sequence = sequences[index];
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    if (sequence.load(std::memory_order_acquire) < 2) {
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (uint32_t version; (version = sequence.load(std::memory_order_acquire)) < 2;) {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0) {
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            WaitOnWord(sequence, version, static_cast<unsigned>(remaining.count()));
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    record = Read(index);
+    return true;
+}
+
+inline void RecordStore::Execute(Operation *operations, size_t count) {
+    bool anyWrite = std::any_of(operations, operations + count,
+                                [](const Operation &operation) { return operation.kind == OperationKind::Write; });
+    bool versionWrite = versions && anyWrite;
+    if (lockMode == LockMode::Striped) {
+        uint64_t commit = versionWrite ? lastCommit.fetch_add(1, std::memory_order_relaxed) + 1 : 0;
+        ExecuteStriped(operations, count, commit);
+        Publish(commit);
+        return;
+    }
+
+    anyWrite ? globalLock.Lock() : globalLock.LockShared();
+    // Under the exclusive lock, batches take commits in the order they run,
+    // so publishing never waits.
+    uint64_t commit = versionWrite ? lastCommit.fetch_add(1, std::memory_order_relaxed) + 1 : 0;
+    for (size_t i = 0; i < count; ++i) {
+        Operation &operation = operations[i];
+        if (operation.kind == OperationKind::Read) {
+            operation.record = Load(operation.index, operation.written);
+            continue;
+        }
+        uint32_t ref = layout.Intern(operation.name);
+        operation.written = ref != RecordLayout::NO_NAME;
+        if (!operation.written) continue;
+        operation.record = {operation.id, ref};
+        Store(operation.index, operation.id, ref, commit);
+    }
+    Publish(commit);
+    anyWrite ? globalLock.Unlock() : globalLock.UnlockShared();
+}
+
+inline void RecordStore::ExecuteStriped(Operation *operations, size_t count, uint64_t commit) {
+    // Resolve every name first, under one shared arena lock; only names new
+    // to the dictionary take it again exclusively.
+    arenaLock.LockShared();
+    for (size_t i = 0; i < count; ++i) {
+        if (operations[i].kind == OperationKind::Write) {
+            operations[i].record = {operations[i].id, layout.Find(operations[i].name)};
+        }
+    }
+    arenaLock.UnlockShared();
+
+    // Work through the batch in chunks of 64, grouped by stripe with a
+    // counting sort that keeps batch order within a stripe. A stripe is
+    // locked once for all of its operations if any of them writes; reads in
+    // other stripes stay optimistic.
+    for (size_t base = 0; base < count; base += 64) {
+        size_t chunk = std::min<size_t>(count - base, 64);
+        Operation *batch = operations + base;
+        size_t starts[STRIPES + 1] = {};
+        uint8_t order[64];
+        for (size_t i = 0; i < chunk; ++i) starts[StripeOf(batch[i].index) + 1]++;
+        for (size_t stripe = 0; stripe < STRIPES; ++stripe) starts[stripe + 1] += starts[stripe];
+        for (size_t i = 0; i < chunk; ++i) order[starts[StripeOf(batch[i].index)]++] = static_cast<uint8_t>(i);
+
+        for (size_t begin = 0; begin < chunk;) {
+            size_t stripe = StripeOf(batch[order[begin]].index);
+            size_t end = begin;
+            bool anyWrite = false;
+            for (; end < chunk && StripeOf(batch[order[end]].index) == stripe; ++end) {
+                if (batch[order[end]].kind == OperationKind::Write) anyWrite = true;
+            }
+
+            if (anyWrite) stripes[stripe].lock.lock();
+            for (size_t i = begin; i < end; ++i) {
+                Operation &operation = batch[order[i]];
+                if (operation.kind == OperationKind::Read) {
+                    operation.record = anyWrite ? Load(operation.index, operation.written)
+                                                : ReadOptimistic(operation.index, nullptr, operation.written);
+                    continue;
+                }
+                if (operation.record.name == RecordLayout::NO_NAME) {
+                    operation.record.name = InternName(operation.name);
+                }
+                operation.written = operation.record.name != RecordLayout::NO_NAME;
+                if (operation.written) Store(operation.index, operation.id, operation.record.name, commit);
+            }
+            if (anyWrite) stripes[stripe].lock.unlock();
+            begin = end;
+        }
+    }
+}
+
+inline void RecordStore::AddVersion(int index, int id, uint32_t ref, uint64_t commit) {
+    std::atomic<Version *> &head = versions[index];
+    Version *newest = new Version{id, ref, commit, {head.load(std::memory_order_relaxed)}};
+    head.store(newest, std::memory_order_release);
+
+    // Every open snapshot stops at or before the first version at or below
+    // the horizon, so the versions behind it can go. newest itself is above
+    // the horizon, since its batch is not published yet, and a reader that
+    // loaded the old head reaches the same cut.
+    uint64_t oldest = horizon.load(std::memory_order_acquire);
+    Version *keep = newest;
+    while (keep && keep->commit > oldest) keep = keep->older.load(std::memory_order_relaxed);
+    if (!keep) return;
+    for (Version *stale = keep->older.exchange(nullptr, std::memory_order_relaxed); stale;) {
+        Version *older = stale->older.load(std::memory_order_relaxed);
+        delete stale;
+        stale = older;
+    }
+}
+
+inline void RecordStore::Publish(uint64_t commit) {
+    if (commit == 0) return;
+    // Striped batches finish out of order but are published in order, so a
+    // snapshot never sees a batch without the ones before it. The wait is
+    // only for batches still being applied, and no stripe is held meanwhile.
+    for (unsigned attempt = 0; published.load(std::memory_order_acquire) != commit - 1; ++attempt) {
+        if (attempt % 64 == 63) std::this_thread::yield();
+    }
+    published.store(commit, std::memory_order_release);
+    if (commit % 64 == 0) UpdateHorizon();
+}
+
+inline void RecordStore::UpdateHorizon() {
+    // published is read before the table: a snapshot announced too late to
+    // be seen here reads a commit at least this one.
+    uint64_t oldest = published.load(std::memory_order_seq_cst);
+    for (const SnapshotSlot &snapshot : snapshots) {
+        oldest = std::min(oldest, snapshot.commit.load(std::memory_order_seq_cst));
+    }
+    uint64_t current = horizon.load(std::memory_order_relaxed);
+    while (oldest > current && !horizon.compare_exchange_weak(current, oldest, std::memory_order_release)) {
+    }
+}
+
+inline RecordStore::Snapshot RecordStore::OpenSnapshot() const {
+    for (;;) {
+        for (SnapshotSlot &snapshot : snapshots) {
+            uint64_t free = NO_SNAPSHOT;
+            uint64_t floor = published.load(std::memory_order_acquire);
+            if (!snapshot.commit.compare_exchange_strong(free, floor, std::memory_order_seq_cst)) continue;
+            // Announced before reading the commit to use, which is at least
+            // floor, so no horizon computed meanwhile is above it.
+            return Snapshot(*this, &snapshot.commit, published.load(std::memory_order_seq_cst));
+        }
+        std::this_thread::yield();
+    }
+}
+
+inline void RecordStore::Snapshot::Close() {
+    if (slot) slot->store(NO_SNAPSHOT, std::memory_order_release);
+    slot = nullptr;
+}
+
+inline bool RecordStore::Snapshot::Read(int index, Record &record) const {
+    if (!store->versions) return false;
+    const Version *version = store->versions[index].load(std::memory_order_acquire);
+    while (version && version->commit > commit) version = version->older.load(std::memory_order_acquire);
+    if (!version) return false;
+    record = {version->id, version->name};
+    return true;
+}
+
+template <typename Visit>
+void RecordStore::Snapshot::ForEach(Visit visit) const {
+    Record record;
+    for (uint32_t index = 0; index < store->slotCount; ++index) {
+        if (Read(static_cast<int>(index), record)) visit(static_cast<int>(index), record);
+    }
+}
+
+#endif //LAB4_RECORD_STORE_H
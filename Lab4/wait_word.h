@@ -0,0 +1,43 @@
+#ifndef LAB4_WAIT_WORD_H
+#define LAB4_WAIT_WORD_H
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Blocking on a 32-bit atomic word: WaitOnAddress on Windows, a private
+// futex on Linux. Both check the word against expected atomically with
+// going to sleep, so a wake after the word changes is never lost.
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain 32-bit word");
+
+// Sleeps while word holds expected, for at most timeoutMs milliseconds.
+// May return early or spuriously; callers re-check the word.
+inline void WaitOnWord(const std::atomic<uint32_t> &word, uint32_t expected, unsigned timeoutMs) {
+#ifdef _WIN32
+    WaitOnAddress(const_cast<std::atomic<uint32_t> *>(&word), &expected, sizeof(expected), timeoutMs);
+#else
+    timespec timeout{static_cast<time_t>(timeoutMs / 1000), static_cast<long>(timeoutMs % 1000) * 1000000};
+    syscall(SYS_futex, reinterpret_cast<const uint32_t *>(&word), FUTEX_WAIT_PRIVATE, expected, &timeout, nullptr, 0);
+#endif
+}
+
+// Wakes every thread waiting on word.
+inline void WakeWord(std::atomic<uint32_t> &word) {
+#ifdef _WIN32
+    WakeByAddressAll(&word);
+#else
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+#endif //LAB4_WAIT_WORD_H
@@ -0,0 +1,203 @@
+#ifndef LAB4_WORKER_POOL_H
+#define LAB4_WORKER_POOL_H
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "mpmc_queue.h"
+#include "record_store.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#endif
+
+// Counting semaphore: a Win32 semaphore or a POSIX sem_t.
+class Semaphore {
+public:
+#ifdef _WIN32
+    Semaphore() { handle = CreateSemaphore(NULL, 0, LONG_MAX, NULL); }
+    ~Semaphore() { CloseHandle(handle); }
+    void Post() { ReleaseSemaphore(handle, 1, NULL); }
+    void Wait() { WaitForSingleObject(handle, INFINITE); }
+#else
+    Semaphore() { sem_init(&semaphore, 0, 0); }
+    ~Semaphore() { sem_destroy(&semaphore); }
+    void Post() { sem_post(&semaphore); }
+    void Wait() {
+        while (sem_wait(&semaphore) != 0) {
+        }
+    }
+#endif
+
+    Semaphore(const Semaphore &) = delete;
+    Semaphore &operator=(const Semaphore &) = delete;
+
+private:
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    sem_t semaphore;
+#endif
+};
+
+// Called on a worker thread for every finished operation.
+using CompletionCallback = void (*)(const Operation &operation, void *context);
+
+// Fixed set of worker threads executing operations against a RecordStore.
+//
+// Submit copies the operation into a preallocated cell of a lock-free MPMC
+// queue, so a request costs no thread creation and no allocation. A worker
+// pops up to BATCH operations and runs them with one RecordStore::Execute
+// call, i.e. one lock acquisition for the batch. Idle workers spin briefly,
+// then sleep on a semaphore that Submit posts only while someone sleeps.
+class WorkerPool {
+public:
+    static const size_t BATCH = 32;
+
+    WorkerPool(RecordStore &store, size_t numThreads, size_t queueCapacity = 4096,
+               CompletionCallback onComplete = nullptr, void *context = nullptr);
+    ~WorkerPool() { Shutdown(); }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    // Queues operation, waiting for room if the queue is full.
+    void Submit(const Operation &operation);
+    // Returns once every submitted operation has completed.
+    void WaitIdle();
+    // Finishes the queued operations and stops the workers.
+    void Shutdown();
+
+    size_t completed() const { return completedCount.load(std::memory_order_acquire); }
+
+private:
+    static const unsigned SPINS = 256;
+
+    RecordStore &store;
+    MpmcQueue<Operation> queue;
+    CompletionCallback onComplete;
+    void *context;
+    Semaphore wakeup;
+    std::atomic<size_t> sleeping{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> submittedCount{0};
+    std::atomic<size_t> completedCount{0};
+#ifdef _WIN32
+    std::vector<HANDLE> threads;
+    static DWORD WINAPI ThreadMain(LPVOID pool);
+#else
+    std::vector<pthread_t> threads;
+    static void *ThreadMain(void *pool);
+#endif
+
+    void Run();
+    size_t PopBatch(Operation *batch);
+};
+
+inline WorkerPool::WorkerPool(RecordStore &store, size_t numThreads, size_t queueCapacity,
+                              CompletionCallback onComplete, void *context)
+        : store(store), queue(queueCapacity), onComplete(onComplete), context(context) {
+    for (size_t i = 0; i < numThreads; ++i) {
+#ifdef _WIN32
+        HANDLE thread = CreateThread(NULL, 0, ThreadMain, this, 0, NULL);
+        if (!thread) {
+            std::cerr << "Failed to create worker thread with error: " << GetLastError() << std::endl;
+            continue;
+        }
+#else
+        pthread_t thread;
+        if (pthread_create(&thread, nullptr, ThreadMain, this) != 0) {
+            std::cerr << "Failed to create worker thread" << std::endl;
+            continue;
+        }
+#endif
+        threads.push_back(thread);
+    }
+}
+
+#ifdef _WIN32
+inline DWORD WINAPI WorkerPool::ThreadMain(LPVOID pool) {
+    static_cast<WorkerPool *>(pool)->Run();
+    return 0;
+}
+#else
+inline void *WorkerPool::ThreadMain(void *pool) {
+    static_cast<WorkerPool *>(pool)->Run();
+    return nullptr;
+}
+#endif
+
+inline void WorkerPool::Submit(const Operation &operation) {
+    submittedCount.fetch_add(1, std::memory_order_relaxed);
+    while (!queue.TryPush(operation)) std::this_thread::yield();
+    // Pairs with the fence in Run: either the worker going to sleep sees
+    // this operation, or this thread sees it sleeping.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed) > 0) wakeup.Post();
+}
+
+inline void WorkerPool::WaitIdle() {
+    while (completedCount.load(std::memory_order_acquire) != submittedCount.load(std::memory_order_relaxed)) {
+        std::this_thread::yield();
+    }
+}
+
+inline void WorkerPool::Shutdown() {
+    if (stopping.exchange(true)) return;
+    for (size_t i = 0; i < threads.size(); ++i) wakeup.Post();
+    for (auto thread : threads) {
+#ifdef _WIN32
+        WaitForSingleObject(thread, INFINITE);
+        CloseHandle(thread);
+#else
+        pthread_join(thread, nullptr);
+#endif
+    }
+    threads.clear();
+}
+
+inline size_t WorkerPool::PopBatch(Operation *batch) {
+    size_t count = 0;
+    while (count < BATCH && queue.TryPop(batch[count])) ++count;
+    return count;
+}
+
+inline void WorkerPool::Run() {
+    Operation batch[BATCH];
+    for (;;) {
+        size_t count = 0;
+        for (unsigned spin = 0; spin < SPINS && count == 0; ++spin) {
+            count = PopBatch(batch);
+            if (count == 0 && spin % 16 == 15) std::this_thread::yield();
+        }
+
+        if (count == 0) {
+            sleeping.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            count = PopBatch(batch);
+            if (count == 0) {
+                if (stopping.load(std::memory_order_acquire)) {
+                    sleeping.fetch_sub(1, std::memory_order_relaxed);
+                    return;
+                }
+                wakeup.Wait();
+            }
+            sleeping.fetch_sub(1, std::memory_order_relaxed);
+            if (count == 0) continue;
+        }
+
+        store.Execute(batch, count);
+        if (onComplete) {
+            for (size_t i = 0; i < count; ++i) onComplete(batch[i], context);
+        }
+        completedCount.fetch_add(count, std::memory_order_release);
+    }
+}
+
+#endif //LAB4_WORKER_POOL_H
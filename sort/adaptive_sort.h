@@ -0,0 +1,323 @@
+#ifndef SORT_ADAPTIVE_SORT_H
+#define SORT_ADAPTIVE_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include "parallel_sort.h"
+#include "task_pool.h"
+
+// Natural runs shorter than this are grouped with their neighbours and
+// sorted as one block, as TimSort does below its minrun.
+const size_t ADAPTIVE_MIN_RUN = 1024;
+// Consecutive wins by one side before the merge switches to galloping.
+const size_t ADAPTIVE_MIN_GALLOP = 7;
+
+struct AdaptiveSortStats {
+    size_t naturalRuns = 0;
+    size_t descendingRuns = 0;
+    size_t mergedRuns = 0;
+    size_t mergeRounds = 0;
+    bool fellBack = false;
+};
+
+struct RunSegment {
+    size_t begin;
+    size_t end;
+    bool descending;
+    bool needsSort;
+};
+
+template<typename T, typename Compare>
+struct RunScanTaskData {
+    T *array;
+    size_t begin;
+    size_t end;
+    const Compare *comp;
+    std::vector<RunSegment> segments;
+    size_t naturalRuns;
+    size_t descendingRuns;
+};
+
+// Splits [begin, end) into maximal non-descending or strictly descending
+// runs. Short runs are grouped into blocks of at least ADAPTIVE_MIN_RUN
+// elements that are later sorted as a whole.
+template<typename T, typename Compare>
+void RunScanCallback(void *param) {
+    auto *data = static_cast<RunScanTaskData<T, Compare> *>(param);
+    const T *a = data->array;
+    const Compare &comp = *data->comp;
+    data->segments.clear();
+    data->naturalRuns = 0;
+    data->descendingRuns = 0;
+
+    RunSegment pending{data->begin, data->begin, false, false};
+    size_t pendingRuns = 0;
+    auto flush = [&]() {
+        if (pendingRuns == 0) return;
+        if (pendingRuns > 1) pending.descending = false;
+        pending.needsSort = pendingRuns > 1;
+        data->segments.push_back(pending);
+        pendingRuns = 0;
+    };
+
+    for (size_t i = data->begin; i < data->end;) {
+        size_t j = i + 1;
+        bool descending = j < data->end && comp(a[j], a[i]);
+        if (descending) {
+            while (j < data->end && comp(a[j], a[j - 1])) ++j;
+        } else {
+            while (j < data->end && !comp(a[j], a[j - 1])) ++j;
+        }
+        ++data->naturalRuns;
+        if (descending) ++data->descendingRuns;
+
+        if (j - i >= ADAPTIVE_MIN_RUN) {
+            flush();
+            data->segments.push_back({i, j, descending, false});
+        } else {
+            if (pendingRuns == 0) pending = {i, j, descending, false};
+            else pending.end = j;
+            ++pendingRuns;
+            if (pending.end - pending.begin >= ADAPTIVE_MIN_RUN) flush();
+        }
+        i = j;
+    }
+    flush();
+}
+
+template<typename T, typename Compare>
+struct RunFixTaskData {
+    T *array;
+    const std::vector<RunSegment> *segments;
+    size_t threadId;
+    size_t numThreads;
+    const Compare *comp;
+};
+
+// Each worker sorts every numThreads-th grouped block and swaps its share of
+// the pairs of every descending run, so one long reversed run still uses all
+// workers.
+template<typename T, typename Compare>
+void RunFixCallback(void *param) {
+    auto *data = static_cast<RunFixTaskData<T, Compare> *>(param);
+    const std::vector<RunSegment> &segments = *data->segments;
+
+    for (size_t s = 0; s < segments.size(); ++s) {
+        const RunSegment &segment = segments[s];
+        if (segment.needsSort && s % data->numThreads == data->threadId) {
+            sortChunk(data->array + segment.begin, data->array + segment.end, *data->comp);
+        } else if (segment.descending) {
+            size_t pairs = (segment.end - segment.begin) / 2;
+            size_t first = pairs * data->threadId / data->numThreads;
+            size_t last = pairs * (data->threadId + 1) / data->numThreads;
+            for (size_t x = first; x < last; ++x) {
+                std::swap(data->array[segment.begin + x], data->array[segment.end - 1 - x]);
+            }
+        }
+    }
+}
+
+// Number of leading elements of arr[0..n) that satisfy a predicate which is
+// true on a prefix: exponential probing, then binary search in the last step.
+template<typename T, typename Predicate>
+size_t gallop(const T *arr, size_t n, Predicate predicate) {
+    size_t low = 0, step = 1;
+    while (low + step <= n && predicate(arr[low + step - 1])) {
+        low += step;
+        step <<= 1;
+    }
+    size_t high = std::min(low + step, n);
+    return std::partition_point(arr + low, arr + high, predicate) - arr;
+}
+
+// Stable merge of a[0..m) and b[0..n) into dst. Once one side wins
+// ADAPTIVE_MIN_GALLOP times in a row, its whole winning stretch is found by
+// galloping and copied in one block.
+template<typename T, typename Compare>
+void gallopingMerge(const T *a, size_t m, const T *b, size_t n, T *dst, const Compare &comp) {
+    size_t i = 0, j = 0, winsA = 0, winsB = 0;
+    while (i < m && j < n) {
+        if (!comp(b[j], a[i])) {
+            *dst++ = a[i++];
+            winsB = 0;
+            if (++winsA >= ADAPTIVE_MIN_GALLOP) {
+                const T &pivot = b[j];
+                size_t count = gallop(a + i, m - i, [&](const T &x) { return !comp(pivot, x); });
+                dst = std::copy(a + i, a + i + count, dst);
+                i += count;
+                winsA = 0;
+            }
+        } else {
+            *dst++ = b[j++];
+            winsA = 0;
+            if (++winsB >= ADAPTIVE_MIN_GALLOP) {
+                const T &pivot = a[i];
+                size_t count = gallop(b + j, n - j, [&](const T &x) { return comp(x, pivot); });
+                dst = std::copy(b + j, b + j + count, dst);
+                j += count;
+                winsB = 0;
+            }
+        }
+    }
+    dst = std::copy(a + i, a + m, dst);
+    std::copy(b + j, b + n, dst);
+}
+
+// One merge-path slice of a natural-run merge round: output [begin, end) of
+// merging runs 2p and 2p+1 for every pair p, where run r is
+// [bounds[r], bounds[r + 1]).
+template<typename T, typename Compare>
+struct RunMergeTaskData {
+    const T *source;
+    T *target;
+    const std::vector<size_t> *bounds;
+    size_t begin;
+    size_t end;
+    const Compare *comp;
+};
+
+template<typename T, typename Compare>
+void RunMergeCallback(void *param) {
+    auto *data = static_cast<RunMergeTaskData<T, Compare> *>(param);
+    const std::vector<size_t> &bounds = *data->bounds;
+    const Compare &comp = *data->comp;
+    size_t lastRun = bounds.size() - 1;
+
+    size_t run = std::upper_bound(bounds.begin(), bounds.end(), data->begin) - bounds.begin() - 1;
+    for (size_t pair = run / 2 * 2; pair < lastRun && bounds[pair] < data->end; pair += 2) {
+        size_t left = bounds[pair];
+        size_t mid = bounds[std::min(pair + 1, lastRun)];
+        size_t right = bounds[std::min(pair + 2, lastRun)];
+        size_t outBegin = std::max(data->begin, left);
+        size_t outEnd = std::min(data->end, right);
+
+        const T *a = data->source + left;
+        const T *b = data->source + mid;
+        size_t i = coRank(outBegin - left, a, mid - left, b, right - mid, comp);
+        size_t iEnd = coRank(outEnd - left, a, mid - left, b, right - mid, comp);
+        size_t j = outBegin - left - i;
+        size_t jEnd = outEnd - left - iEnd;
+        gallopingMerge(a + i, iEnd - i, b + j, jEnd - j, data->target + outBegin, comp);
+    }
+}
+
+template<typename T>
+struct RunCopyTaskData {
+    const T *source;
+    T *target;
+    size_t begin;
+    size_t end;
+};
+
+template<typename T>
+void RunCopyCallback(void *param) {
+    auto *data = static_cast<RunCopyTaskData<T> *>(param);
+    std::copy(data->source + data->begin, data->source + data->end, data->target + data->begin);
+}
+
+// Presortedness-adaptive sort. A parallel scan finds natural runs; descending
+// runs are reversed, short ones grouped and sorted, and adjacent runs that
+// are already in order are joined. Sorted input therefore costs one O(n)
+// scan. Otherwise runs are merged pairwise with galloping merges, each round
+// split into equal merge-path slices. When fewer than half of the elements
+// are in long natural runs, the input is treated as unsorted and handed to
+// sortAndMerge.
+template<typename T, typename Compare = std::less<>>
+AdaptiveSortStats adaptiveSort(T *arr, T *buffer, size_t size, size_t numThreads, TaskPool &pool,
+                               Compare comp = Compare()) {
+    AdaptiveSortStats stats;
+    if (size == 0) return stats;
+
+    std::vector<RunScanTaskData<T, Compare>> scanData(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        scanData[i].array = arr;
+        scanData[i].begin = sliceBegin(size, numThreads, i);
+        scanData[i].end = sliceBegin(size, numThreads, i + 1);
+        scanData[i].comp = &comp;
+        pool.submit(RunScanCallback<T, Compare>, &scanData[i], i);
+    }
+    pool.wait();
+
+    // Join runs that continue across slice boundaries.
+    std::vector<RunSegment> segments;
+    size_t sortedElements = 0;
+    for (auto &data : scanData) {
+        stats.naturalRuns += data.naturalRuns;
+        stats.descendingRuns += data.descendingRuns;
+        for (const RunSegment &segment : data.segments) {
+            if (!segments.empty() && !segments.back().needsSort && !segment.needsSort) {
+                RunSegment &previous = segments.back();
+                const T &tail = arr[previous.end - 1];
+                const T &head = arr[segment.begin];
+                bool bothAscending = !previous.descending && !segment.descending && !comp(head, tail);
+                bool bothDescending = previous.descending && segment.descending && comp(head, tail);
+                if (bothAscending || bothDescending) {
+                    previous.end = segment.end;
+                    --stats.naturalRuns;
+                    if (bothDescending) --stats.descendingRuns;
+                    continue;
+                }
+            }
+            segments.push_back(segment);
+        }
+    }
+    // Short runs left on their own, e.g. at the end of a slice, need no sort
+    // but say nothing about presortedness, so only long runs count.
+    size_t longRun = std::min(ADAPTIVE_MIN_RUN, size);
+    for (const RunSegment &segment : segments) {
+        size_t length = segment.end - segment.begin;
+        if (!segment.needsSort && length >= longRun) sortedElements += length;
+    }
+
+    if (sortedElements * 2 < size) {
+        stats.fellBack = true;
+        sortAndMerge(arr, buffer, size, numThreads, pool, comp);
+        return stats;
+    }
+
+    std::vector<RunFixTaskData<T, Compare>> fixData(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        fixData[i] = {arr, &segments, i, numThreads, &comp};
+        pool.submit(RunFixCallback<T, Compare>, &fixData[i], i);
+    }
+    pool.wait();
+
+    std::vector<size_t> bounds{0};
+    for (size_t s = 1; s < segments.size(); ++s) {
+        if (comp(arr[segments[s].begin], arr[segments[s].begin - 1])) bounds.push_back(segments[s].begin);
+    }
+    bounds.push_back(size);
+    stats.mergedRuns = bounds.size() - 1;
+
+    T *source = arr;
+    T *target = buffer;
+    std::vector<RunMergeTaskData<T, Compare>> mergeData(numThreads);
+    while (bounds.size() > 2) {
+        for (size_t i = 0; i < numThreads; ++i) {
+            mergeData[i] = {source, target, &bounds, sliceBegin(size, numThreads, i), sliceBegin(size, numThreads, i + 1), &comp};
+            pool.submit(RunMergeCallback<T, Compare>, &mergeData[i], i);
+        }
+        pool.wait();
+
+        std::vector<size_t> merged;
+        for (size_t r = 0; r < bounds.size(); r += 2) merged.push_back(bounds[r]);
+        if (merged.back() != size) merged.push_back(size);
+        bounds.swap(merged);
+        std::swap(source, target);
+        ++stats.mergeRounds;
+    }
+
+    if (source != arr) {
+        std::vector<RunCopyTaskData<T>> copyData(numThreads);
+        for (size_t i = 0; i < numThreads; ++i) {
+            copyData[i] = {source, arr, sliceBegin(size, numThreads, i), sliceBegin(size, numThreads, i + 1)};
+            pool.submit(RunCopyCallback<T>, &copyData[i], i);
+        }
+        pool.wait();
+    }
+    return stats;
+}
+
+#endif //SORT_ADAPTIVE_SORT_H
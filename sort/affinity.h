@@ -0,0 +1,156 @@
+#ifndef SORT_AFFINITY_H
+#define SORT_AFFINITY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "task_pool.h"
+
+#ifdef __linux__
+#include <sched.h>
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
+#endif
+
+// How sort workers are placed:
+// None leaves scheduling to the OS.
+// Core pins each worker to one CPU.
+// Node pins each worker to the CPUs of one NUMA node.
+// Workers are assigned in contiguous blocks in node order, so neighbouring
+// chunks, and the early merge rounds that combine them, stay on one node.
+enum class AffinityMode {
+    None,
+    Core,
+    Node
+};
+
+inline bool parseAffinity(const std::string &name, AffinityMode &mode) {
+    if (name == "none") mode = AffinityMode::None;
+    else if (name == "core") mode = AffinityMode::Core;
+    else if (name == "node") mode = AffinityMode::Node;
+    else return false;
+    return true;
+}
+
+struct WorkerPlacement {
+    int node;
+    std::vector<int> cpus;
+};
+
+// Worker-to-CPU plan for a pool of numThreads workers. Pinning uses
+// sched_setaffinity, and node ids come from libnuma when the build has it.
+// Without libnuma all CPUs count as node 0. On other platforms nothing is pinned.
+class AffinityPlan {
+public:
+    AffinityPlan(AffinityMode mode, size_t numThreads) : mode(mode) {
+#ifdef __linux__
+        if (mode == AffinityMode::None) return;
+
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+
+        // Allowed CPUs as (node, cpu), sorted so each node's CPUs are adjacent.
+        std::vector<std::pair<int, int>> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) cpus.emplace_back(nodeOfCpu(cpu), cpu);
+        }
+        std::sort(cpus.begin(), cpus.end());
+        if (cpus.empty()) return;
+
+        std::vector<int> nodes;
+        for (const auto &entry : cpus) {
+            if (nodes.empty() || nodes.back() != entry.first) nodes.push_back(entry.first);
+        }
+
+        for (size_t worker = 0; worker < numThreads; ++worker) {
+            WorkerPlacement placement;
+            if (mode == AffinityMode::Core) {
+                const auto &entry = cpus[worker * cpus.size() / numThreads];
+                placement.node = entry.first;
+                placement.cpus.push_back(entry.second);
+            } else {
+                placement.node = nodes[worker * nodes.size() / numThreads];
+                for (const auto &entry : cpus) {
+                    if (entry.first == placement.node) placement.cpus.push_back(entry.second);
+                }
+            }
+            placements.push_back(placement);
+        }
+        nodeCount = nodes.size();
+#else
+        (void) numThreads;
+#endif
+    }
+
+    bool pinned() const { return !placements.empty(); }
+
+    // Start callback for TaskPool; empty when nothing is pinned, which keeps
+    // the pool's plain work-stealing behaviour.
+    WorkerStartCallback workerStart() const {
+        if (!pinned()) return WorkerStartCallback();
+        return [this](size_t worker) { pinCurrentThread(worker); };
+    }
+
+    void pinCurrentThread(size_t worker) const {
+#ifdef __linux__
+        if (worker >= placements.size()) return;
+        const WorkerPlacement &placement = placements[worker];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : placement.cpus) CPU_SET(cpu, &set);
+        sched_setaffinity(0, sizeof(set), &set);
+#ifdef HAVE_LIBNUMA
+        if (numa_available() >= 0) numa_set_preferred(placement.node);
+#endif
+#else
+        (void) worker;
+#endif
+    }
+
+    void report(std::ostream &out) const {
+        if (!pinned()) {
+            out << "Affinity: " << (mode == AffinityMode::None ? "none" : "unavailable, workers not pinned") << "\n";
+            return;
+        }
+        out << "Affinity: " << (mode == AffinityMode::Core ? "core" : "node") << ", " << nodeCount
+            << " NUMA node(s)" << (numaAvailable() ? "" : " (libnuma unavailable)") << "\n";
+        for (size_t worker = 0; worker < placements.size(); ++worker) {
+            const WorkerPlacement &placement = placements[worker];
+            out << "  Worker " << worker << ": node " << placement.node << ", CPU";
+            if (placement.cpus.size() == 1) {
+                out << " " << placement.cpus[0];
+            } else {
+                out << "s " << placement.cpus.front() << "-" << placement.cpus.back()
+                    << " (" << placement.cpus.size() << ")";
+            }
+            out << "\n";
+        }
+    }
+
+private:
+    static bool numaAvailable() {
+#ifdef HAVE_LIBNUMA
+        return numa_available() >= 0;
+#else
+        return false;
+#endif
+    }
+
+    static int nodeOfCpu(int cpu) {
+#ifdef HAVE_LIBNUMA
+        if (numa_available() >= 0) return std::max(numa_node_of_cpu(cpu), 0);
+#endif
+        (void) cpu;
+        return 0;
+    }
+
+    AffinityMode mode;
+    std::vector<WorkerPlacement> placements;
+    size_t nodeCount = 0;
+};
+
+#endif //SORT_AFFINITY_H
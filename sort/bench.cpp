@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "parallel_sort.h"
+#include "sort_engine.h"
+#include "task_pool.h"
+
+// Non-interactive benchmark: sweeps sizes, thread counts, input
+// distributions and engines, and reports the median of several timed
+// repetitions after warmup runs, with throughput and speedup over one thread.
+
+enum class Distribution {
+    Uniform,
+    Sorted,
+    Reverse,
+    FewUnique,
+    Zipf,
+    OrganPipe
+};
+
+const std::vector<std::pair<std::string, Distribution>> DISTRIBUTIONS = {
+        {"uniform",    Distribution::Uniform},
+        {"sorted",     Distribution::Sorted},
+        {"reverse",    Distribution::Reverse},
+        {"few-unique", Distribution::FewUnique},
+        {"zipf",       Distribution::Zipf},
+        {"organ-pipe", Distribution::OrganPipe},
+};
+
+std::vector<size_t> generate(Distribution distribution, size_t size, std::mt19937_64 &rng) {
+    std::vector<size_t> data(size);
+    switch (distribution) {
+        case Distribution::Uniform:
+            for (auto &value : data) value = rng();
+            break;
+        case Distribution::Sorted:
+            for (size_t i = 0; i < size; ++i) data[i] = i;
+            break;
+        case Distribution::Reverse:
+            for (size_t i = 0; i < size; ++i) data[i] = size - i;
+            break;
+        case Distribution::FewUnique:
+            for (auto &value : data) value = rng() % 16;
+            break;
+        case Distribution::Zipf: {
+            // Inverse-CDF sampling over up to 2^20 ranks with exponent 1.
+            size_t ranks = std::min<size_t>(std::max<size_t>(size, 1), size_t(1) << 20);
+            std::vector<double> cumulative(ranks);
+            double sum = 0;
+            for (size_t rank = 0; rank < ranks; ++rank) cumulative[rank] = sum += 1.0 / (rank + 1);
+            std::uniform_real_distribution<double> uniform(0.0, sum);
+            for (auto &value : data) {
+                value = std::lower_bound(cumulative.begin(), cumulative.end(), uniform(rng)) - cumulative.begin();
+            }
+            break;
+        }
+        case Distribution::OrganPipe:
+            for (size_t i = 0; i < size; ++i) data[i] = i < size / 2 ? i : size - i;
+            break;
+    }
+    return data;
+}
+
+struct BenchOptions {
+    std::vector<size_t> sizes = {1'000'000, 10'000'000};
+    std::vector<size_t> threads = {1, 2, 4, 8};
+    std::vector<std::string> distributions;
+    std::vector<SortEngine> engines = {SortEngine::Merge, SortEngine::Radix, SortEngine::Adaptive};
+    size_t repetitions = 5;
+    size_t warmup = 1;
+    unsigned long long seed = 42;
+    std::string csvPath;
+    std::string jsonPath;
+};
+
+struct BenchResult {
+    std::string engine;
+    std::string distribution;
+    size_t size;
+    size_t threads;
+    double minSeconds;
+    double medianSeconds;
+    double meanSeconds;
+    double elementsPerSecond;
+    double speedup;
+};
+
+std::vector<std::string> splitList(const std::string &value) {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// Accepts plain integers and scientific shorthand such as 1e7.
+bool parseSizes(const std::string &value, std::vector<size_t> &sizes) {
+    sizes.clear();
+    for (const auto &item : splitList(value)) {
+        double parsed = std::strtod(item.c_str(), nullptr);
+        if (parsed < 1) return false;
+        sizes.push_back(static_cast<size_t>(parsed));
+    }
+    return !sizes.empty();
+}
+
+// Thread counts are whole numbers; "2.9" is rejected rather than cut to 2.
+bool parseCounts(const std::string &value, std::vector<size_t> &counts) {
+    counts.clear();
+    for (const auto &item : splitList(value)) {
+        char *end = nullptr;
+        size_t count = std::strtoull(item.c_str(), &end, 10);
+        if (count == 0 || *end != '\0') return false;
+        counts.push_back(count);
+    }
+    return !counts.empty();
+}
+
+bool parseOptions(int argc, char *argv[], BenchOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string name = arg;
+        std::string value;
+        size_t equals = arg.find('=');
+        if (equals != std::string::npos) {
+            name = arg.substr(0, equals);
+            value = arg.substr(equals + 1);
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        } else {
+            return false;
+        }
+
+        if (name == "--sizes") {
+            if (!parseSizes(value, options.sizes)) return false;
+        } else if (name == "--threads") {
+            if (!parseCounts(value, options.threads)) return false;
+        } else if (name == "--distributions") {
+            options.distributions = splitList(value);
+            for (const auto &distribution : options.distributions) {
+                bool known = std::any_of(DISTRIBUTIONS.begin(), DISTRIBUTIONS.end(),
+                                         [&](const auto &entry) { return entry.first == distribution; });
+                if (!known) return false;
+            }
+        } else if (name == "--engines") {
+            options.engines.clear();
+            for (const auto &engineName : splitList(value)) {
+                SortEngine engine;
+                if (!parseEngine(engineName, engine)) return false;
+                options.engines.push_back(engine);
+            }
+            if (options.engines.empty()) return false;
+        } else if (name == "--repetitions") {
+            options.repetitions = std::strtoull(value.c_str(), nullptr, 10);
+            if (options.repetitions == 0) return false;
+        } else if (name == "--warmup") {
+            options.warmup = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (name == "--seed") {
+            options.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (name == "--csv") {
+            options.csvPath = value;
+        } else if (name == "--json") {
+            options.jsonPath = value;
+        } else {
+            return false;
+        }
+    }
+
+    if (options.distributions.empty()) {
+        for (const auto &entry : DISTRIBUTIONS) options.distributions.push_back(entry.first);
+    }
+    // Speedup is reported against the single-threaded run, so it is always measured.
+    if (std::find(options.threads.begin(), options.threads.end(), 1) == options.threads.end()) {
+        options.threads.push_back(1);
+    }
+    std::sort(options.threads.begin(), options.threads.end());
+    return true;
+}
+
+void writeCsv(std::ostream &out, const std::vector<BenchResult> &results) {
+    out << "engine,distribution,size,threads,min_seconds,median_seconds,mean_seconds,elements_per_second,speedup\n";
+    for (const auto &result : results) {
+        out << result.engine << ',' << result.distribution << ',' << result.size << ',' << result.threads << ','
+            << result.minSeconds << ',' << result.medianSeconds << ',' << result.meanSeconds << ','
+            << result.elementsPerSecond << ',' << result.speedup << '\n';
+    }
+}
+
+void writeJson(std::ostream &out, const std::vector<BenchResult> &results) {
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto &result = results[i];
+        out << "  {\"engine\": \"" << result.engine << "\", \"distribution\": \"" << result.distribution
+            << "\", \"size\": " << result.size << ", \"threads\": " << result.threads
+            << ", \"min_seconds\": " << result.minSeconds << ", \"median_seconds\": " << result.medianSeconds
+            << ", \"mean_seconds\": " << result.meanSeconds
+            << ", \"elements_per_second\": " << result.elementsPerSecond
+            << ", \"speedup\": " << result.speedup << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--sizes N,...] [--threads N,...]"
+                  << " [--distributions uniform,sorted,reverse,few-unique,zipf,organ-pipe]"
+                  << " [--engines merge,radix,adaptive] [--repetitions N] [--warmup N] [--seed N]"
+                  << " [--csv FILE] [--json FILE]\n";
+        return 1;
+    }
+    progressOutput = false;
+    std::cerr << "Small-sort kernel: " << smallSortKernelName() << "\n";
+
+    std::vector<BenchResult> results;
+    std::map<std::tuple<std::string, std::string, size_t>, double> singleThreadSeconds;
+
+    for (size_t size : options.sizes) {
+        std::vector<size_t> work(size);
+        std::vector<size_t> buffer(size);
+
+        for (const auto &distribution : options.distributions) {
+            Distribution kind = std::find_if(DISTRIBUTIONS.begin(), DISTRIBUTIONS.end(),
+                                             [&](const auto &entry) { return entry.first == distribution; })->second;
+            // Each case gets its own generator, so its input does not depend
+            // on which other sizes and distributions were selected.
+            std::seed_seq caseSeed{options.seed, options.seed >> 32, static_cast<unsigned long long>(kind),
+                                   static_cast<unsigned long long>(size), static_cast<unsigned long long>(size) >> 32};
+            std::mt19937_64 rng(caseSeed);
+            std::vector<size_t> input = generate(kind, size, rng);
+
+            for (size_t numThreads : options.threads) {
+                if (numThreads > size) continue;
+                TaskPool pool(numThreads);
+
+                for (SortEngine engine : options.engines) {
+                    std::vector<double> seconds;
+                    for (size_t run = 0; run < options.warmup + options.repetitions; ++run) {
+                        std::copy(input.begin(), input.end(), work.begin());
+
+                        auto start = std::chrono::steady_clock::now();
+                        sortInMemory(engine, work.data(), buffer.data(), size, numThreads, pool);
+                        auto end = std::chrono::steady_clock::now();
+
+                        if (!std::is_sorted(work.begin(), work.end())) {
+                            std::cerr << engineName(engine) << " produced unsorted output for " << distribution
+                                      << ", size " << size << ", " << numThreads << " threads\n";
+                            return 1;
+                        }
+                        if (run >= options.warmup) seconds.push_back(std::chrono::duration<double>(end - start).count());
+                    }
+
+                    std::sort(seconds.begin(), seconds.end());
+                    BenchResult result{};
+                    result.engine = engineName(engine);
+                    result.distribution = distribution;
+                    result.size = size;
+                    result.threads = numThreads;
+                    result.minSeconds = seconds.front();
+                    result.medianSeconds = seconds[seconds.size() / 2];
+                    for (double value : seconds) result.meanSeconds += value / seconds.size();
+                    result.elementsPerSecond = size / result.medianSeconds;
+
+                    auto key = std::make_tuple(result.engine, distribution, size);
+                    if (numThreads == 1) singleThreadSeconds[key] = result.medianSeconds;
+                    result.speedup = singleThreadSeconds.count(key) ? singleThreadSeconds[key] / result.medianSeconds : 0;
+
+                    std::cerr << result.engine << " " << distribution << " n=" << size << " t=" << numThreads
+                              << ": " << result.medianSeconds << " s, " << result.elementsPerSecond / 1e6
+                              << " M elements/s, speedup " << result.speedup << "\n";
+                    results.push_back(result);
+                }
+            }
+        }
+    }
+
+    if (options.csvPath.empty()) {
+        writeCsv(std::cout, results);
+    } else {
+        std::ofstream csv(options.csvPath);
+        writeCsv(csv, results);
+        if (!csv) {
+            std::cerr << "Failed to write " << options.csvPath << "\n";
+            return 1;
+        }
+    }
+    if (!options.jsonPath.empty()) {
+        std::ofstream json(options.jsonPath);
+        writeJson(json, results);
+        if (!json) {
+            std::cerr << "Failed to write " << options.jsonPath << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
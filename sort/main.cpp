@@ -1,170 +1,324 @@
-#include <windows.h>
 #include <iostream>
 #include <vector>
 #include <algorithm>
 #include <mutex>
-#include <pdh.h>
-#include <numeric>
-#include <atomic>
+#include <chrono>
+#include <limits>
+#include <thread>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include "affinity.h"
+#include "parallel_sort.h"
+#include "resource_monitor.h"
+#include "sort_engine.h"
+#include "task_pool.h"
+
+// A record as stored by our production jobs: a key plus an opaque payload.
+struct SortRecord {
+    size_t key;
+    char payload[64];
+};
 
-std::mutex coutMutex;
-std::atomic<bool> monitoringCpu(true);
+enum class RecordMode {
+    None,
+    Move,
+    KeyIndex
+};
 
-class CpuMonitor {
+// Buffered sequential reader over one sorted run file.
+class RunReader {
 public:
-    CpuMonitor() {
-        PdhOpenQuery(NULL, 0, &cpuQuery);
-        PdhAddEnglishCounterW(cpuQuery, L"\\Processor(_Total)\\% Processor Time", 0, &cpuTotal);
-        PdhCollectQueryData(cpuQuery);
-        Sleep(1000);
+    RunReader(const std::string &path, size_t bufferElements) : buffer(std::max<size_t>(bufferElements, 1)) {
+        file = std::fopen(path.c_str(), "rb");
+        if (file) refill();
     }
 
-    ~CpuMonitor() {
-        PdhCloseQuery(cpuQuery);
+    ~RunReader() {
+        if (file) std::fclose(file);
     }
 
-    double getCpuUsage() {
-        PDH_FMT_COUNTERVALUE counterVal;
-        PdhCollectQueryData(cpuQuery);
-        PdhGetFormattedCounterValue(cpuTotal, PDH_FMT_DOUBLE, NULL, &counterVal);
-        return counterVal.doubleValue;
+    RunReader(const RunReader &) = delete;
+    RunReader &operator=(const RunReader &) = delete;
+
+    bool isOpen() const { return file != nullptr; }
+    bool exhausted() const { return position == count; }
+    size_t current() const { return buffer[position]; }
+
+    void advance() {
+        if (++position == count) refill();
     }
 
 private:
-    PDH_HQUERY cpuQuery{};
-    PDH_HCOUNTER cpuTotal{};
+    void refill() {
+        count = std::fread(buffer.data(), sizeof(size_t), buffer.size(), file);
+        position = 0;
+    }
+
+    std::FILE *file = nullptr;
+    std::vector<size_t> buffer;
+    size_t position = 0;
+    size_t count = 0;
 };
 
+// Tournament tree of losers over k runs: tree[0] holds the index of the
+// smallest head, each inner node the loser of the match played there. Taking
+// the next element replays only the log2(k) matches on the winner's path.
+class LoserTree {
+public:
+    explicit LoserTree(std::vector<std::unique_ptr<RunReader>> &runs) : runs(runs), tree(runs.size(), runs.size()) {
+        for (size_t leaf = runs.size(); leaf-- > 0;) replay(leaf);
+    }
+
+    bool empty() const { return runs.empty() || runs[tree[0]]->exhausted(); }
+    size_t top() const { return runs[tree[0]]->current(); }
+
+    void pop() {
+        runs[tree[0]]->advance();
+        replay(tree[0]);
+    }
 
-DWORD WINAPI monitorCpuUsage(LPVOID param) {
-    auto *cpuMonitor = static_cast<CpuMonitor *>(param);
-    std::vector<double> cpuUsageValues;
+private:
+    // Leaf k is a virtual sentinel that beats everything while the tree is built.
+    bool beats(size_t a, size_t b) const {
+        size_t k = runs.size();
+        if (a == k) return b != k;
+        if (b == k || runs[a]->exhausted()) return false;
+        if (runs[b]->exhausted()) return true;
+        return runs[a]->current() < runs[b]->current() || (runs[a]->current() == runs[b]->current() && a < b);
+    }
 
-    while (monitoringCpu) {
-        double cpuUsage = cpuMonitor->getCpuUsage();
-        {
-            std::lock_guard<std::mutex> lock(coutMutex);
-            cpuUsageValues.push_back(cpuUsage);
+    void replay(size_t leaf) {
+        size_t winner = leaf;
+        for (size_t node = (leaf + runs.size()) / 2; node > 0; node /= 2) {
+            if (beats(tree[node], winner)) std::swap(tree[node], winner);
         }
-        Sleep(1000);
+        tree[0] = winner;
     }
 
-    double averageCpuUsage = std::accumulate(cpuUsageValues.begin(), cpuUsageValues.end(), 0.0) / cpuUsageValues.size();
-    std::lock_guard<std::mutex> lock(coutMutex);
-    // std::cout << "Average CPU load during execution: " << averageCpuUsage << "%\n";
+    std::vector<std::unique_ptr<RunReader>> &runs;
+    std::vector<size_t> tree;
+};
+
+struct ExternalSortOptions {
+    std::string inputPath;
+    std::string outputPath;
+    std::string tempDir;
+    size_t memoryBudget;
+    SortEngine engine;
+};
 
-    return 0;
+bool writeElements(std::FILE *file, const size_t *data, size_t count) {
+    return std::fwrite(data, sizeof(size_t), count, file) == count;
 }
 
-void merge(size_t *arr, size_t left, size_t mid, size_t right) {
-    size_t leftSize = mid - left + 1;
-    size_t rightSize = right - mid;
-    std::vector<size_t> leftArray(leftSize), rightArray(rightSize);
+// Merges runPaths into outputPath with one loser tree. The memory budget is
+// split evenly between the run read buffers and the output buffer.
+bool mergeRuns(const std::vector<std::string> &runPaths, const std::string &outputPath, size_t memoryBudget) {
+    size_t streamElements = memoryBudget / sizeof(size_t) / (runPaths.size() + 1);
+
+    std::vector<std::unique_ptr<RunReader>> runs;
+    for (const auto &path : runPaths) {
+        runs.emplace_back(new RunReader(path, streamElements));
+        if (!runs.back()->isOpen()) {
+            std::cerr << "Failed to open run file " << path << std::endl;
+            return false;
+        }
+    }
+
+    std::FILE *output = std::fopen(outputPath.c_str(), "wb");
+    if (!output) {
+        std::cerr << "Failed to create " << outputPath << std::endl;
+        return false;
+    }
 
-    for (size_t i = 0; i < leftSize; ++i) leftArray[i] = arr[left + i];
-    for (size_t i = 0; i < rightSize; ++i) rightArray[i] = arr[mid + 1 + i];
+    std::vector<size_t> outputBuffer(std::max<size_t>(streamElements, 1));
+    size_t buffered = 0;
+    bool ok = true;
 
-    size_t i = 0, j = 0, k = left;
-    while (i < leftSize && j < rightSize) {
-        if (leftArray[i] <= rightArray[j]) arr[k++] = leftArray[i++];
-        else arr[k++] = rightArray[j++];
+    for (LoserTree tree(runs); !tree.empty() && ok; tree.pop()) {
+        outputBuffer[buffered++] = tree.top();
+        if (buffered == outputBuffer.size()) {
+            ok = writeElements(output, outputBuffer.data(), buffered);
+            buffered = 0;
+        }
+    }
+    if (ok) ok = writeElements(output, outputBuffer.data(), buffered);
+
+    if (std::fclose(output) != 0 || !ok) {
+        std::cerr << "Failed to write " << outputPath << std::endl;
+        return false;
     }
-    while (i < leftSize) arr[k++] = leftArray[i++];
-    while (j < rightSize) arr[k++] = rightArray[j++];
+    return true;
 }
 
-struct TaskData {
-    size_t *array;
-    size_t left;
-    size_t mid;
-    size_t right;
-    size_t threadId;
-};
+// Sorts a binary file of native size_t keys that may not fit in memory. Runs
+// of memoryBudget / 2 bytes are sorted in memory with the selected engine
+// (the other half is its merge buffer) and spilled to tempDir, then merged
+// with a loser tree. If the budget cannot give every run a read buffer of at
+// least MIN_STREAM_ELEMENTS, runs are merged in several passes.
+bool externalSort(const ExternalSortOptions &options, size_t numThreads, TaskPool &pool) {
+    const size_t MIN_STREAM_ELEMENTS = size_t(1) << 16;
+    size_t runElements = std::max<size_t>(options.memoryBudget / (2 * sizeof(size_t)), 1);
+    size_t maxFanIn = std::max<size_t>(options.memoryBudget / sizeof(size_t) / MIN_STREAM_ELEMENTS, 3) - 1;
+
+    std::FILE *input = std::fopen(options.inputPath.c_str(), "rb");
+    if (!input) {
+        std::cerr << "Failed to open " << options.inputPath << std::endl;
+        return false;
+    }
 
-VOID CALLBACK SortCallback(PTP_CALLBACK_INSTANCE, PVOID param, PTP_WORK) {
-    auto *data = static_cast<TaskData *>(param);
+    std::filesystem::path tempDir = options.tempDir.empty() ? std::filesystem::temp_directory_path()
+                                                            : std::filesystem::path(options.tempDir);
+    std::string runPrefix = "sort_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    size_t nextRunId = 0;
+    auto newRunPath = [&]() {
+        return (tempDir / (runPrefix + "_" + std::to_string(nextRunId++) + ".run")).string();
+    };
+
+    std::vector<std::string> runPaths;
+    std::vector<std::string> createdPaths;
+    bool ok = true;
 
     {
-        std::lock_guard<std::mutex> lock(coutMutex);
-        std::cout << "Thread " << data->threadId << ": started sorting from "
-                  << data->left << " to " << data->right << "\n";
+        std::vector<size_t> run(runElements);
+        std::vector<size_t> buffer(runElements);
+        size_t count;
+
+        while (ok && (count = std::fread(run.data(), sizeof(size_t), runElements, input)) > 0) {
+            sortInMemory(options.engine, run.data(), buffer.data(), count, numThreads, pool);
+
+            std::string path = newRunPath();
+            std::FILE *runFile = std::fopen(path.c_str(), "wb");
+            ok = runFile != nullptr;
+            if (ok) {
+                createdPaths.push_back(path);
+                runPaths.push_back(path);
+                ok = writeElements(runFile, run.data(), count);
+                ok = std::fclose(runFile) == 0 && ok;
+            }
+            if (!ok) std::cerr << "Failed to write run file " << path << std::endl;
+        }
+        if (ok && std::ferror(input)) {
+            std::cerr << "Failed to read " << options.inputPath << std::endl;
+            ok = false;
+        }
     }
-
-    std::sort(data->array + data->left, data->array + data->right + 1);
+    std::fclose(input);
 
     {
         std::lock_guard<std::mutex> lock(coutMutex);
-        std::cout << "Thread " << data->threadId << ": done sorting\n";
+        std::cout << "External sort: " << runPaths.size() << " runs of up to " << runElements << " keys\n";
     }
-}
 
+    std::error_code ignored;
+    while (ok && runPaths.size() > maxFanIn) {
+        std::vector<std::string> nextPaths;
+        for (size_t first = 0; ok && first < runPaths.size(); first += maxFanIn) {
+            std::vector<std::string> group(runPaths.begin() + first,
+                                           runPaths.begin() + std::min(first + maxFanIn, runPaths.size()));
+            std::string path = newRunPath();
+            createdPaths.push_back(path);
+            ok = mergeRuns(group, path, options.memoryBudget);
+            nextPaths.push_back(path);
+            // Runs left behind are removed by the final cleanup.
+            for (const auto &merged : group) std::filesystem::remove(merged, ignored);
+        }
+        runPaths.swap(nextPaths);
+    }
 
-VOID CALLBACK MergeCallback(PTP_CALLBACK_INSTANCE, PVOID param, PTP_WORK) {
-    auto *data = static_cast<TaskData *>(param);
-    merge(data->array, data->left, data->mid, data->right);
+    if (ok) ok = mergeRuns(runPaths, options.outputPath, options.memoryBudget);
 
-    std::lock_guard<std::mutex> lock(coutMutex);
-    std::cout << "\nThread " << data->threadId << ": merged " << data->left << " to " << data->right << "\n";
+    for (const auto &path : createdPaths) std::filesystem::remove(path, ignored);
+    return ok;
 }
 
-void parallelSort(size_t *arr, size_t size, size_t numThreads, PTP_POOL pool, PTP_CLEANUP_GROUP cleanupGroup,
-                  PTP_CALLBACK_ENVIRON callbackEnviron) {
-
-    size_t chunkSize = size / numThreads;
-    std::vector<TaskData> threadData(numThreads);
-    std::vector<PTP_WORK> workItems(numThreads);
-
-    for (size_t i = 0; i < numThreads; ++i) {
-        size_t left = i * chunkSize;
-        size_t right = (i == numThreads - 1) ? size - 1 : (left + chunkSize - 1);
-        threadData[i] = {arr, left, 0, right, i};
-
-        workItems[i] = CreateThreadpoolWork(SortCallback, &threadData[i], callbackEnviron);
-        SubmitThreadpoolWork(workItems[i]);
-    }
+struct InitTaskData {
+    size_t *array;
+    size_t *buffer;
+    size_t begin;
+    size_t end;
+};
 
-    for (size_t i = 0; i < numThreads; ++i) {
-        WaitForThreadpoolWorkCallbacks(workItems[i], FALSE);
-        CloseThreadpoolWork(workItems[i]);
+// Writes the test pattern. Run on the worker that later sorts the chunk, this
+// is the first touch that places the chunk's pages on that worker's node.
+void InitCallback(void *param) {
+    auto *data = static_cast<InitTaskData *>(param);
+    for (size_t j = data->begin; j < data->end; ++j) {
+        data->array[j] = j % 10;
+        data->buffer[j] = 0;
     }
 }
 
-void parallelMerge(size_t *arr, size_t size, size_t numThreads, PTP_POOL pool, PTP_CLEANUP_GROUP cleanupGroup,
-                   PTP_CALLBACK_ENVIRON callbackEnviron) {
-    size_t chunkSize = size / numThreads;
-    std::vector<TaskData> threadData(numThreads);
-    std::vector<PTP_WORK> workItems(numThreads);
+// Initialises arr and buffer with the same slices as the merge and radix
+// workers. The initial chunk sort ends its first chunks a few elements
+// earlier, which never moves more than part of a page.
+void firstTouch(size_t *arr, size_t *buffer, size_t size, size_t numThreads, TaskPool &pool) {
+    if (size == 0) return;
+    std::vector<InitTaskData> threadData(numThreads);
 
-    for (size_t mergeSize = chunkSize; mergeSize < size; mergeSize *= 2) {
-        size_t currentThreads = numThreads / 2;
+    for (size_t i = 0; i < numThreads; ++i) {
+        threadData[i] = {arr, buffer, sliceBegin(size, numThreads, i), sliceBegin(size, numThreads, i + 1)};
+        pool.submit(InitCallback, &threadData[i], i);
+    }
 
-        for (size_t i = 0; i < currentThreads; ++i) {
-            size_t left = i * 2 * mergeSize;
-            size_t mid = std::min(left + mergeSize - 1, size - 1);
-            size_t right = std::min(left + 2 * mergeSize - 1, size - 1);
+    pool.wait();
+}
 
-            threadData[i] = {arr, left, mid, right, i};
+struct SortOptions {
+    SortEngine engine = SortEngine::Merge;
+    std::string inputPath;
+    std::string outputPath;
+    std::string tempDir;
+    size_t memoryMb = 1024;
+    RecordMode records = RecordMode::None;
+    size_t sampleMs = 100;
+    AffinityMode affinity = AffinityMode::None;
+};
 
-            workItems[i] = CreateThreadpoolWork(MergeCallback, &threadData[i], callbackEnviron);
-            SubmitThreadpoolWork(workItems[i]);
+bool parseOptions(int argc, char *argv[], SortOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string name = arg;
+        std::string value;
+        size_t equals = arg.find('=');
+        if (equals != std::string::npos) {
+            name = arg.substr(0, equals);
+            value = arg.substr(equals + 1);
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        } else {
+            return false;
         }
 
-        for (size_t i = 0; i < currentThreads; ++i) {
-            WaitForThreadpoolWorkCallbacks(workItems[i], FALSE);
-            CloseThreadpoolWork(workItems[i]);
+        if (name == "--engine") {
+            if (!parseEngine(value, options.engine)) return false;
+        } else if (name == "--records") {
+            if (value == "move") options.records = RecordMode::Move;
+            else if (value == "key-index") options.records = RecordMode::KeyIndex;
+            else return false;
+        } else if (name == "--sample-ms") {
+            options.sampleMs = std::strtoull(value.c_str(), nullptr, 10);
+            if (options.sampleMs == 0) return false;
+        } else if (name == "--affinity") {
+            if (!parseAffinity(value, options.affinity)) return false;
+        } else if (name == "--input") {
+            options.inputPath = value;
+        } else if (name == "--output") {
+            options.outputPath = value;
+        } else if (name == "--temp-dir") {
+            options.tempDir = value;
+        } else if (name == "--memory-mb") {
+            options.memoryMb = std::strtoull(value.c_str(), nullptr, 10);
+            if (options.memoryMb == 0) return false;
+        } else {
+            return false;
         }
-
-        numThreads /= 2;
-    }
-}
-
-void sortAndMerge(size_t *arr, size_t size, size_t numThreads, PTP_POOL pool, PTP_CLEANUP_GROUP cleanupGroup,
-                  PTP_CALLBACK_ENVIRON callbackEnviron) {
-    if (numThreads == 1) {
-
     }
-    parallelSort(arr, size, numThreads, pool, cleanupGroup, callbackEnviron);
-    parallelMerge(arr, size, numThreads, pool, cleanupGroup, callbackEnviron);
+    if (options.records != RecordMode::None && !options.inputPath.empty()) return false;
+    return options.inputPath.empty() == options.outputPath.empty();
 }
 
 
@@ -183,53 +337,79 @@ void getInput(size_t &variable, const std::string &prompt, size_t minValue, size
     }
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    SortOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--engine merge|radix|adaptive]"
+                  << " [--records move|key-index] [--sample-ms MS] [--affinity none|core|node]"
+                  << " [--input FILE --output FILE [--memory-mb MB] [--temp-dir DIR]]\n";
+        return 1;
+    }
+    bool external = !options.inputPath.empty();
+    bool records = options.records != RecordMode::None;
+
     size_t size = 0, numThreads = 0;
-    getInput(size, "Enter array size (0 - 1'000'000'000): ", 1, 1'000'000'000);
-    size_t maxNumThreads = size > 64 ? 64 : size;
+    if (!external) getInput(size, "Enter array size (0 - 1'000'000'000): ", 1, 1'000'000'000);
+    size_t maxNumThreads = (external || size > 64) ? 64 : size;
     getInput(numThreads, "Enter number of threads: ", 1, maxNumThreads);
 
-    std::vector<size_t> array(size);
-    for (size_t j = 0; j < size; ++j) array[j] = j % 10;
+    ResourceMonitor resourceMonitor(std::chrono::milliseconds(options.sampleMs));
 
-    CpuMonitor cpuMonitor;
-    std::cout << "CPU load before start: " << cpuMonitor.getCpuUsage() << "%\n";
+    AffinityPlan affinityPlan(options.affinity, numThreads);
+    TaskPool pool(numThreads, affinityPlan.workerStart());
+    affinityPlan.report(std::cout);
 
-    PTP_POOL pool = CreateThreadpool(NULL);
-    SetThreadpoolThreadMaximum(pool, numThreads);
-    SetThreadpoolThreadMinimum(pool, 0);
+    size_t arraySize = (records || external) ? 0 : size;
+    std::unique_ptr<size_t[]> array(new size_t[arraySize]);
+    std::unique_ptr<size_t[]> buffer(new size_t[arraySize]);
+    firstTouch(array.get(), buffer.get(), arraySize, numThreads, pool);
 
-    PTP_CLEANUP_GROUP cleanupGroup = CreateThreadpoolCleanupGroup();
-    TP_CALLBACK_ENVIRON callbackEnviron;
-    InitializeThreadpoolEnvironment(&callbackEnviron);
-    SetThreadpoolCallbackPool(&callbackEnviron, pool);
-    SetThreadpoolCallbackCleanupGroup(&callbackEnviron, cleanupGroup, NULL);
+    std::vector<SortRecord> recordArray(records ? size : 0);
+    for (size_t j = 0; j < recordArray.size(); ++j) recordArray[j] = {j % 10, "Record"};
+    auto recordKey = [](const SortRecord &record) { return record.key; };
 
+    std::cout << "CPU load before start: " << resourceMonitor.getCpuUsage() << "%\n";
 
-    HANDLE cpuMonitorThread = CreateThread(NULL, 0, monitorCpuUsage, &cpuMonitor, 0, NULL);
+    resourceMonitor.start();
 
+    bool ok = true;
+    AdaptiveSortStats adaptiveStats;
     auto start = std::chrono::high_resolution_clock::now();
-    sortAndMerge(array.data(), size, numThreads, pool, cleanupGroup, &callbackEnviron);
+    if (external) {
+        ok = externalSort({options.inputPath, options.outputPath, options.tempDir,
+                           options.memoryMb * 1024 * 1024, options.engine}, numThreads, pool);
+    } else if (options.records == RecordMode::KeyIndex) {
+        sortRecords<SortStrategy::KeyIndex>(recordArray.data(), size, numThreads, pool, recordKey);
+    } else if (options.records == RecordMode::Move) {
+        sortRecords<SortStrategy::MoveRecords>(recordArray.data(), size, numThreads, pool, recordKey);
+    } else {
+        sortInMemory(options.engine, array.get(), buffer.get(), size, numThreads, pool, &adaptiveStats);
+    }
     auto end = std::chrono::high_resolution_clock::now();
+    resourceMonitor.stop();
 
     std::chrono::duration<double> duration = end - start;
-    std::cout << "\nExecution time: " << duration.count() << " seconds\n";
-
-    monitoringCpu = false;
-
-
-    WaitForSingleObject(cpuMonitorThread, INFINITE);
-    CloseHandle(cpuMonitorThread);
-
-    CloseThreadpoolCleanupGroupMembers(cleanupGroup, FALSE, NULL);
-    CloseThreadpoolCleanupGroup(cleanupGroup);
-    CloseThreadpool(pool);
-    DestroyThreadpoolEnvironment(&callbackEnviron);
+    std::cout << "\nEngine: " << (records ? "merge" : engineName(options.engine))
+              << (external ? " (external)" : "")
+              << (options.records == RecordMode::Move ? " (records)" : "")
+              << (options.records == RecordMode::KeyIndex ? " (key-index records)" : "") << "\n";
+    if (options.engine == SortEngine::Adaptive && !external && !records) {
+        std::cout << "Natural runs: " << adaptiveStats.naturalRuns << " (" << adaptiveStats.descendingRuns
+                  << " descending)";
+        if (adaptiveStats.fellBack) {
+            std::cout << ", too fragmented, sorted with merge\n";
+        } else {
+            std::cout << ", " << adaptiveStats.mergedRuns << " after joining, "
+                      << adaptiveStats.mergeRounds << " merge round(s)\n";
+        }
+    }
+    std::cout << "Execution time: " << duration.count() << " seconds\n";
+    std::cout << "Small-sort kernel: " << smallSortKernelName() << "\n";
 
 //    for (size_t i = 0; i < size; ++i) {
 //        std::cout << array[i];
 //    }
 
-    std::cout << "CPU load after execution: " << cpuMonitor.getCpuUsage() << "%\n";
-    return 0;
-}
\ No newline at end of file
+    resourceMonitor.printSummary(std::cout);
+    return ok ? 0 : 1;
+}
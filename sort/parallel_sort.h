@@ -0,0 +1,312 @@
+#ifndef SORT_PARALLEL_SORT_H
+#define SORT_PARALLEL_SORT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "simd_sort.h"
+#include "task_pool.h"
+
+inline std::mutex coutMutex;
+// Per-thread progress lines; benchmarks turn them off.
+inline std::atomic<bool> progressOutput{true};
+
+// Worker i's share of size elements split evenly among numThreads:
+// [sliceBegin(i), sliceBegin(i + 1)). Merge rounds, the radix passes and the
+// first touch all use it, so each worker keeps the pages it placed.
+inline size_t sliceBegin(size_t size, size_t numThreads, size_t i) {
+    return size * i / numThreads;
+}
+
+struct Identity {
+    template<typename T>
+    const T &operator()(const T &value) const { return value; }
+};
+
+// Orders elements by comparing their projections, e.g. the key of a record.
+template<typename Projection, typename Compare>
+struct ProjectedCompare {
+    Projection projection;
+    Compare compare;
+
+    template<typename A, typename B>
+    bool operator()(const A &a, const B &b) const { return compare(projection(a), projection(b)); }
+};
+
+// Number of elements taken from a[0..m) among the first k outputs of merging
+// a and b. Ties go to a, so splitting a merge at co-ranks keeps it stable.
+template<typename T, typename Compare>
+size_t coRank(size_t k, const T *a, size_t m, const T *b, size_t n, const Compare &comp) {
+    size_t low = k > n ? k - n : 0;
+    size_t high = std::min(k, m);
+    while (low < high) {
+        size_t i = low + (high - low) / 2;
+        size_t j = k - i;
+        if (j > 0 && !comp(b[j - 1], a[i])) low = i + 1;
+        else high = i;
+    }
+    return low;
+}
+
+// Writes dst[outBegin..outEnd) of the merge of src[left..mid] and src[mid+1..right].
+template<typename T, typename Compare>
+void merge(const T *src, T *dst, size_t left, size_t mid, size_t right, size_t outBegin, size_t outEnd,
+           const Compare &comp) {
+    const T *leftArray = src + left;
+    const T *rightArray = src + mid + 1;
+    size_t leftSize = mid - left + 1;
+    size_t rightSize = right - mid;
+
+    size_t i = coRank(outBegin - left, leftArray, leftSize, rightArray, rightSize, comp);
+    size_t j = outBegin - left - i;
+    size_t iEnd = coRank(outEnd - left, leftArray, leftSize, rightArray, rightSize, comp);
+    size_t jEnd = outEnd - left - iEnd;
+
+    size_t k = outBegin;
+    while (i < iEnd && j < jEnd) {
+        if (!comp(rightArray[j], leftArray[i])) dst[k++] = leftArray[i++];
+        else dst[k++] = rightArray[j++];
+    }
+    while (i < iEnd) dst[k++] = leftArray[i++];
+    while (j < jEnd) dst[k++] = rightArray[j++];
+}
+
+template<typename T, typename Compare>
+struct TaskData {
+    T *array;
+    T *target;
+    size_t left;
+    size_t mid;
+    size_t right;
+    size_t threadId;
+    const Compare *comp;
+};
+
+// One merge-path slice of a merge round: output positions [begin, end) of
+// merging neighbouring sorted runs of width mergeSize from source into target.
+template<typename T, typename Compare>
+struct MergeTaskData {
+    const T *source;
+    T *target;
+    size_t size;
+    size_t mergeSize;
+    size_t begin;
+    size_t end;
+    size_t threadId;
+    const Compare *comp;
+};
+
+// Plain ascending size_t keys go through the SIMD small-sort kernel.
+template<typename T, typename Compare>
+void sortChunk(T *first, T *last, const Compare &comp) {
+    if constexpr (std::is_same_v<T, size_t> &&
+                  (std::is_same_v<Compare, std::less<>> || std::is_same_v<Compare, std::less<size_t>>)) {
+        simdSort(first, static_cast<size_t>(last - first));
+    } else {
+        std::sort(first, last, comp);
+    }
+}
+
+template<typename T, typename Compare>
+void SortCallback(void *param) {
+    auto *data = static_cast<TaskData<T, Compare> *>(param);
+
+    if (progressOutput) {
+        std::lock_guard<std::mutex> lock(coutMutex);
+        std::cout << "Thread " << data->threadId << ": started sorting from "
+                  << data->left << " to " << data->right << "\n";
+    }
+
+    if (data->target != data->array) {
+        std::copy(data->array + data->left, data->array + data->right + 1, data->target + data->left);
+    }
+    sortChunk(data->target + data->left, data->target + data->right + 1, *data->comp);
+
+    if (progressOutput) {
+        std::lock_guard<std::mutex> lock(coutMutex);
+        std::cout << "Thread " << data->threadId << ": done sorting\n";
+    }
+}
+
+
+template<typename T, typename Compare>
+void MergeCallback(void *param) {
+    auto *data = static_cast<MergeTaskData<T, Compare> *>(param);
+    size_t pairSize = 2 * data->mergeSize;
+
+    for (size_t left = data->begin / pairSize * pairSize; left < data->end; left += pairSize) {
+        size_t right = std::min(left + pairSize, data->size) - 1;
+        size_t mid = std::min(left + data->mergeSize - 1, right);
+        merge(data->source, data->target, left, mid, right,
+              std::max(data->begin, left), std::min(data->end, right + 1), *data->comp);
+    }
+
+    if (!progressOutput) return;
+    std::lock_guard<std::mutex> lock(coutMutex);
+    std::cout << "\nThread " << data->threadId << ": merged " << data->begin << " to " << data->end - 1 << "\n";
+}
+
+// Sorts numThreads chunks of arr. The sorted chunks are written to target,
+// which may be arr itself or the merge buffer.
+template<typename T, typename Compare>
+void parallelSort(T *arr, T *target, size_t size, size_t numThreads, TaskPool &pool, const Compare &comp) {
+
+    size_t chunkSize = size / numThreads;
+    std::vector<TaskData<T, Compare>> threadData(numThreads);
+
+    for (size_t i = 0; i < numThreads; ++i) {
+        size_t left = i * chunkSize;
+        size_t right = (i == numThreads - 1) ? size - 1 : (left + chunkSize - 1);
+        threadData[i] = {arr, target, left, 0, right, i, &comp};
+
+        pool.submit(SortCallback<T, Compare>, &threadData[i], i);
+    }
+
+    pool.wait();
+}
+
+inline size_t mergeRounds(size_t size, size_t numThreads) {
+    size_t rounds = 0;
+    for (size_t mergeSize = size / numThreads; mergeSize < size; mergeSize *= 2) ++rounds;
+    return rounds;
+}
+
+// Every round merges neighbouring runs of width mergeSize. The round's output
+// is cut into numThreads equal slices with co-ranks, so all workers stay busy
+// down to the last round instead of halving with each level. Rounds alternate
+// between the two arrays; after an odd number of rounds the result is in buffer.
+template<typename T, typename Compare>
+void parallelMerge(T *arr, T *buffer, size_t size, size_t numThreads, TaskPool &pool, const Compare &comp) {
+    size_t chunkSize = size / numThreads;
+    std::vector<MergeTaskData<T, Compare>> threadData(numThreads);
+    T *source = arr;
+    T *target = buffer;
+
+    for (size_t mergeSize = chunkSize; mergeSize < size; mergeSize *= 2) {
+        for (size_t i = 0; i < numThreads; ++i) {
+            size_t begin = sliceBegin(size, numThreads, i);
+            size_t end = sliceBegin(size, numThreads, i + 1);
+            threadData[i] = {source, target, size, mergeSize, begin, end, i, &comp};
+
+            pool.submit(MergeCallback<T, Compare>, &threadData[i], i);
+        }
+
+        pool.wait();
+        std::swap(source, target);
+    }
+}
+
+// buffer must hold size elements; it is reused by every merge round. When the
+// number of rounds is odd the chunks are sorted straight into buffer, so the
+// last round lands back in arr without a final copy.
+template<typename T, typename Compare = std::less<>>
+void sortAndMerge(T *arr, T *buffer, size_t size, size_t numThreads, TaskPool &pool, Compare comp = Compare()) {
+    bool oddRounds = mergeRounds(size, numThreads) % 2 == 1;
+    parallelSort(arr, oddRounds ? buffer : arr, size, numThreads, pool, comp);
+    parallelMerge(oddRounds ? buffer : arr, oddRounds ? arr : buffer, size, numThreads, pool, comp);
+}
+
+template<typename T, typename Compare = std::less<>>
+void sortAndMerge(T *arr, size_t size, size_t numThreads, TaskPool &pool, Compare comp = Compare()) {
+    std::vector<T> buffer(numThreads > 1 ? size : 0);
+    sortAndMerge(arr, buffer.data(), size, numThreads, pool, comp);
+}
+
+// How sortRecords reorders records:
+// MoveRecords sorts the records themselves, moving whole records in every pass.
+// KeyIndex sorts compact (key, index) pairs and moves each record exactly once
+// in a final gather, which wins once records are much larger than their keys.
+enum class SortStrategy {
+    MoveRecords,
+    KeyIndex
+};
+
+template<typename Key>
+struct KeyIndex {
+    Key key;
+    size_t index;
+};
+
+template<typename T, typename Key>
+struct GatherTaskData {
+    T *records;
+    T *scratch;
+    const KeyIndex<Key> *order;
+    size_t begin;
+    size_t end;
+};
+
+template<typename T, typename Key>
+void GatherCallback(void *param) {
+    auto *data = static_cast<GatherTaskData<T, Key> *>(param);
+    for (size_t i = data->begin; i < data->end; ++i) data->scratch[i] = std::move(data->records[data->order[i].index]);
+}
+
+template<typename T, typename Key>
+void MoveBackCallback(void *param) {
+    auto *data = static_cast<GatherTaskData<T, Key> *>(param);
+    std::move(data->scratch + data->begin, data->scratch + data->end, data->records + data->begin);
+}
+
+template<typename T, typename Key, typename Projection>
+struct ExtractTaskData {
+    const T *records;
+    KeyIndex<Key> *entries;
+    size_t begin;
+    size_t end;
+    const Projection *projection;
+};
+
+template<typename T, typename Key, typename Projection>
+void ExtractCallback(void *param) {
+    auto *data = static_cast<ExtractTaskData<T, Key, Projection> *>(param);
+    for (size_t i = data->begin; i < data->end; ++i) {
+        data->entries[i] = {(*data->projection)(data->records[i]), i};
+    }
+}
+
+// Sorts records by comparator(projection(record)). The strategy is fixed at
+// compile time; KeyIndex requires the projected key to be copyable.
+template<SortStrategy Strategy = SortStrategy::MoveRecords, typename T, typename Projection = Identity,
+        typename Compare = std::less<>>
+void sortRecords(T *records, size_t size, size_t numThreads, TaskPool &pool,
+                 Projection projection = Projection(), Compare comp = Compare()) {
+    numThreads = std::min(numThreads, size);
+    if (numThreads == 0) return;
+
+    if constexpr (Strategy == SortStrategy::MoveRecords) {
+        sortAndMerge(records, size, numThreads, pool, ProjectedCompare<Projection, Compare>{projection, comp});
+    } else {
+        using Key = std::decay_t<std::invoke_result_t<Projection, const T &>>;
+        std::vector<KeyIndex<Key>> entries(size);
+
+        std::vector<ExtractTaskData<T, Key, Projection>> extractData(numThreads);
+        for (size_t i = 0; i < numThreads; ++i) {
+            extractData[i] = {records, entries.data(), sliceBegin(size, numThreads, i), sliceBegin(size, numThreads, i + 1), &projection};
+            pool.submit(ExtractCallback<T, Key, Projection>, &extractData[i], i);
+        }
+        pool.wait();
+
+        auto byKey = [comp](const KeyIndex<Key> &a, const KeyIndex<Key> &b) { return comp(a.key, b.key); };
+        sortAndMerge(entries.data(), size, numThreads, pool, byKey);
+
+        std::vector<T> scratch(size);
+        std::vector<GatherTaskData<T, Key>> gatherData(numThreads);
+        for (size_t i = 0; i < numThreads; ++i) {
+            gatherData[i] = {records, scratch.data(), entries.data(), sliceBegin(size, numThreads, i), sliceBegin(size, numThreads, i + 1)};
+            pool.submit(GatherCallback<T, Key>, &gatherData[i], i);
+        }
+        pool.wait();
+
+        for (size_t i = 0; i < numThreads; ++i) pool.submit(MoveBackCallback<T, Key>, &gatherData[i], i);
+        pool.wait();
+    }
+}
+
+#endif //SORT_PARALLEL_SORT_H
@@ -0,0 +1,130 @@
+#ifndef SORT_RADIX_SORT_H
+#define SORT_RADIX_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include "parallel_sort.h"
+#include "task_pool.h"
+
+inline const size_t RADIX_BITS = 8;
+inline const size_t RADIX_BUCKETS = size_t(1) << RADIX_BITS;
+inline const size_t RADIX_DIGITS = sizeof(size_t) * 8 / RADIX_BITS;
+
+struct RadixTaskData {
+    const size_t *source;
+    size_t *target;
+    size_t begin;
+    size_t end;
+    size_t digit;
+    size_t counts[RADIX_DIGITS][RADIX_BUCKETS];
+    size_t offsets[RADIX_BUCKETS];
+    size_t threadId;
+};
+
+inline size_t radixBucket(size_t value, size_t digit) {
+    return (value >> (digit * RADIX_BITS)) & (RADIX_BUCKETS - 1);
+}
+
+// Counts every digit of the chunk in one pass over the input.
+inline void RadixHistogramCallback(void *param) {
+    auto *data = static_cast<RadixTaskData *>(param);
+    std::memset(data->counts, 0, sizeof(data->counts));
+    for (size_t i = data->begin; i < data->end; ++i) {
+        size_t value = data->source[i];
+        for (size_t digit = 0; digit < RADIX_DIGITS; ++digit) ++data->counts[digit][radixBucket(value, digit)];
+    }
+}
+
+inline void RadixCountCallback(void *param) {
+    auto *data = static_cast<RadixTaskData *>(param);
+    size_t *counts = data->counts[data->digit];
+    std::memset(counts, 0, sizeof(data->counts[0]));
+    for (size_t i = data->begin; i < data->end; ++i) ++counts[radixBucket(data->source[i], data->digit)];
+}
+
+inline void RadixScatterCallback(void *param) {
+    auto *data = static_cast<RadixTaskData *>(param);
+    for (size_t i = data->begin; i < data->end; ++i) {
+        size_t value = data->source[i];
+        data->target[data->offsets[radixBucket(value, data->digit)]++] = value;
+    }
+}
+
+inline void RadixCopyCallback(void *param) {
+    auto *data = static_cast<RadixTaskData *>(param);
+    std::copy(data->source + data->begin, data->source + data->end, data->target + data->begin);
+}
+
+// LSD radix sort over 8-bit digits. Each thread owns a contiguous slice; a
+// pass counts the slice's digits, an exclusive prefix sum over (bucket, thread)
+// gives every thread its private write positions, and the scatter keeps the
+// sort stable. Digits on which all keys agree are skipped: the global
+// histogram of a digit does not change between passes, so it is built once.
+inline void radixSort(size_t *arr, size_t *buffer, size_t size, size_t numThreads, TaskPool &pool) {
+    std::vector<RadixTaskData> threadData(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        threadData[i].source = arr;
+        threadData[i].begin = sliceBegin(size, numThreads, i);
+        threadData[i].end = sliceBegin(size, numThreads, i + 1);
+        threadData[i].threadId = i;
+        pool.submit(RadixHistogramCallback, &threadData[i], i);
+    }
+    pool.wait();
+
+    size_t *source = arr;
+    size_t *target = buffer;
+    bool countsCurrent = true;
+    size_t passes = 0;
+
+    for (size_t digit = 0; digit < RADIX_DIGITS; ++digit) {
+        bool trivial = false;
+        for (size_t bucket = 0; bucket < RADIX_BUCKETS && !trivial; ++bucket) {
+            size_t total = 0;
+            for (auto &data : threadData) total += data.counts[digit][bucket];
+            trivial = total == size;
+        }
+        if (trivial) continue;
+
+        for (auto &data : threadData) {
+            data.source = source;
+            data.target = target;
+            data.digit = digit;
+            if (!countsCurrent) pool.submit(RadixCountCallback, &data, data.threadId);
+        }
+        pool.wait();
+
+        size_t offset = 0;
+        for (size_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket) {
+            for (auto &data : threadData) {
+                data.offsets[bucket] = offset;
+                offset += data.counts[digit][bucket];
+            }
+        }
+
+        for (auto &data : threadData) pool.submit(RadixScatterCallback, &data, data.threadId);
+        pool.wait();
+
+        std::swap(source, target);
+        countsCurrent = false;
+        ++passes;
+    }
+
+    if (source != arr) {
+        for (auto &data : threadData) {
+            data.source = source;
+            data.target = arr;
+            pool.submit(RadixCopyCallback, &data, data.threadId);
+        }
+        pool.wait();
+    }
+
+    if (!progressOutput) return;
+    std::lock_guard<std::mutex> lock(coutMutex);
+    std::cout << "Radix sort: " << passes << " of " << RADIX_DIGITS << " digit passes needed\n";
+}
+
+#endif //SORT_RADIX_SORT_H
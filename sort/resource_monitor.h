@@ -0,0 +1,292 @@
+#ifndef SORT_RESOURCE_MONITOR_H
+#define SORT_RESOURCE_MONITOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <pdh.h>
+#include <psapi.h>
+#include <string>
+#else
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// Raw cumulative counters; utilisation is derived from two consecutive readings.
+struct ResourceCounters {
+    std::vector<unsigned long long> coreBusy;
+    std::vector<unsigned long long> coreTotal;
+    double processCpuSeconds = 0;
+    size_t rssBytes = 0;
+    size_t peakRssBytes = 0;
+    size_t minorFaults = 0;
+    size_t majorFaults = 0;
+    size_t voluntarySwitches = 0;
+    size_t involuntarySwitches = 0;
+};
+
+struct ResourceSample {
+    double seconds;
+    double totalCpu;
+    std::vector<double> coreCpu;
+    double processCores;
+    size_t rssBytes;
+};
+
+#ifdef _WIN32
+
+// PDH per-core counters plus process counters. Windows does not expose
+// per-process context switch counts cheaply, so they are reported as zero.
+class CounterReader {
+public:
+    CounterReader() {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        PdhOpenQuery(NULL, 0, &query);
+        for (DWORD core = 0; core < info.dwNumberOfProcessors; ++core) {
+            std::wstring path = L"\\Processor(" + std::to_wstring(core) + L")\\% Processor Time";
+            PDH_HCOUNTER counter;
+            PdhAddEnglishCounterW(query, path.c_str(), 0, &counter);
+            processorCounters.push_back(counter);
+        }
+        PdhCollectQueryData(query);
+    }
+
+    ~CounterReader() {
+        PdhCloseQuery(query);
+    }
+
+    // PDH already returns interval percentages; they are stored as busy/total
+    // per mille so both backends share the same delta arithmetic.
+    void read(ResourceCounters &counters) {
+        PdhCollectQueryData(query);
+        accumulatedBusy.resize(processorCounters.size());
+        accumulatedTotal.resize(processorCounters.size());
+        for (size_t core = 0; core < processorCounters.size(); ++core) {
+            PDH_FMT_COUNTERVALUE value;
+            PdhGetFormattedCounterValue(processorCounters[core], PDH_FMT_DOUBLE, NULL, &value);
+            accumulatedBusy[core] += static_cast<unsigned long long>(value.doubleValue * 10);
+            accumulatedTotal[core] += 1000;
+        }
+        counters.coreBusy = accumulatedBusy;
+        counters.coreTotal = accumulatedTotal;
+
+        FILETIME creation, exit, kernel, user;
+        GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+        counters.processCpuSeconds = (toTicks(kernel) + toTicks(user)) / 1e7;
+
+        PROCESS_MEMORY_COUNTERS memory;
+        GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory));
+        counters.rssBytes = memory.WorkingSetSize;
+        counters.peakRssBytes = memory.PeakWorkingSetSize;
+        counters.minorFaults = memory.PageFaultCount;
+    }
+
+private:
+    static unsigned long long toTicks(const FILETIME &time) {
+        return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    }
+
+    PDH_HQUERY query{};
+    std::vector<PDH_HCOUNTER> processorCounters;
+    std::vector<unsigned long long> accumulatedBusy;
+    std::vector<unsigned long long> accumulatedTotal;
+};
+
+#else
+
+// /proc/stat for per-core jiffies, /proc/self/stat for process CPU time,
+// faults and RSS, getrusage for context switches and peak RSS.
+class CounterReader {
+public:
+    void read(ResourceCounters &counters) {
+        counters.coreBusy.clear();
+        counters.coreTotal.clear();
+
+        std::ifstream stat("/proc/stat");
+        std::string line;
+        while (std::getline(stat, line)) {
+            if (line.compare(0, 3, "cpu") != 0) break;
+            if (line.size() > 3 && line[3] == ' ') continue;
+
+            std::istringstream fields(line);
+            std::string cpu;
+            unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+            fields >> cpu >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal;
+            unsigned long long busy = user + nice + system + irq + softirq + steal;
+            counters.coreBusy.push_back(busy);
+            counters.coreTotal.push_back(busy + idle + iowait);
+        }
+
+        std::ifstream self("/proc/self/stat");
+        std::string selfStat;
+        std::getline(self, selfStat);
+        size_t commEnd = selfStat.rfind(')');
+        if (commEnd != std::string::npos) {
+            // Fields after the command name start at field 3 (state).
+            std::istringstream fields(selfStat.substr(commEnd + 2));
+            std::vector<unsigned long long> values;
+            std::string field;
+            while (fields >> field && values.size() < 22) {
+                values.push_back(std::strtoull(field.c_str(), nullptr, 10));
+            }
+            if (values.size() >= 22) {
+                static const double ticks = static_cast<double>(sysconf(_SC_CLK_TCK));
+                static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+                counters.minorFaults = values[7];
+                counters.majorFaults = values[9];
+                counters.processCpuSeconds = (values[11] + values[12]) / ticks;
+                counters.rssBytes = values[21] * pageSize;
+            }
+        }
+
+        struct rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        counters.voluntarySwitches = usage.ru_nvcsw;
+        counters.involuntarySwitches = usage.ru_nivcsw;
+        counters.peakRssBytes = static_cast<size_t>(usage.ru_maxrss) * 1024;
+    }
+};
+
+#endif
+
+// Samples system and process counters on a background thread every interval
+// and keeps the series, so a run can be checked for scaling or starvation.
+class ResourceMonitor {
+public:
+    explicit ResourceMonitor(std::chrono::milliseconds interval) : interval(interval) {
+        reader.read(first);
+        last = first;
+        startTime = lastTime = std::chrono::steady_clock::now();
+    }
+
+    ~ResourceMonitor() {
+        stop();
+    }
+
+    ResourceMonitor(const ResourceMonitor &) = delete;
+    ResourceMonitor &operator=(const ResourceMonitor &) = delete;
+
+    // Total CPU utilisation over one sampling interval from now; blocks for
+    // the interval.
+    double getCpuUsage() {
+        std::lock_guard<std::mutex> lock(mutex);
+        reader.read(last);
+        lastTime = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(interval);
+        return takeSample().totalCpu;
+    }
+
+    void start() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            reader.read(first);
+            last = first;
+            startTime = lastTime = std::chrono::steady_clock::now();
+            samples.clear();
+        }
+        running = true;
+        sampler = std::thread(&ResourceMonitor::run, this);
+    }
+
+    void stop() {
+        if (!running.exchange(false)) return;
+        sampler.join();
+        std::lock_guard<std::mutex> lock(mutex);
+        samples.push_back(takeSample());
+    }
+
+    void printSummary(std::ostream &out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (samples.empty()) return;
+
+        double seconds = samples.back().seconds;
+        double averageCpu = 0, peakCpu = 0, averageCores = 0, peakCores = 0;
+        size_t peakRss = 0;
+        std::vector<double> coreAverage(samples.back().coreCpu.size(), 0.0);
+        for (const auto &sample : samples) {
+            averageCpu += sample.totalCpu / samples.size();
+            peakCpu = std::max(peakCpu, sample.totalCpu);
+            peakCores = std::max(peakCores, sample.processCores);
+            peakRss = std::max(peakRss, sample.rssBytes);
+            for (size_t core = 0; core < coreAverage.size() && core < sample.coreCpu.size(); ++core) {
+                coreAverage[core] += sample.coreCpu[core] / samples.size();
+            }
+        }
+        if (seconds > 0) averageCores = (last.processCpuSeconds - first.processCpuSeconds) / seconds;
+
+        out << "Resource summary (" << samples.size() << " samples every " << interval.count() << " ms):\n";
+        out << "  CPU load: average " << averageCpu << "%, peak " << peakCpu << "%\n";
+        out << "  Process CPU: " << averageCores << " cores busy on average, peak " << peakCores << "\n";
+        out << "  Per-core average:";
+        for (size_t core = 0; core < coreAverage.size(); ++core) out << " " << core << ":" << coreAverage[core] << "%";
+        out << "\n";
+        out << "  RSS: peak sampled " << peakRss / (1024 * 1024) << " MB, process peak "
+            << last.peakRssBytes / (1024 * 1024) << " MB\n";
+        out << "  Page faults: " << last.minorFaults - first.minorFaults << " minor, "
+            << last.majorFaults - first.majorFaults << " major\n";
+        out << "  Context switches: " << last.voluntarySwitches - first.voluntarySwitches << " voluntary, "
+            << last.involuntarySwitches - first.involuntarySwitches << " involuntary\n";
+    }
+
+private:
+    void run() {
+        while (running) {
+            std::this_thread::sleep_for(interval);
+            std::lock_guard<std::mutex> lock(mutex);
+            samples.push_back(takeSample());
+        }
+    }
+
+    ResourceSample takeSample() {
+        ResourceCounters current;
+        reader.read(current);
+        auto now = std::chrono::steady_clock::now();
+
+        ResourceSample sample{};
+        sample.seconds = std::chrono::duration<double>(now - startTime).count();
+        sample.rssBytes = current.rssBytes;
+
+        unsigned long long busy = 0, total = 0;
+        for (size_t core = 0; core < current.coreBusy.size() && core < last.coreBusy.size(); ++core) {
+            unsigned long long coreBusy = current.coreBusy[core] - last.coreBusy[core];
+            unsigned long long coreTotal = current.coreTotal[core] - last.coreTotal[core];
+            sample.coreCpu.push_back(coreTotal == 0 ? 0.0 : 100.0 * coreBusy / coreTotal);
+            busy += coreBusy;
+            total += coreTotal;
+        }
+        sample.totalCpu = total == 0 ? 0.0 : 100.0 * busy / total;
+
+        double elapsed = std::chrono::duration<double>(now - lastTime).count();
+        sample.processCores = elapsed > 0 ? (current.processCpuSeconds - last.processCpuSeconds) / elapsed : 0.0;
+
+        last = current;
+        lastTime = now;
+        return sample;
+    }
+
+    std::chrono::milliseconds interval;
+    CounterReader reader;
+    ResourceCounters first;
+    ResourceCounters last;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point lastTime;
+    std::vector<ResourceSample> samples;
+    std::mutex mutex;
+    std::atomic<bool> running{false};
+    std::thread sampler;
+};
+
+#endif //SORT_RESOURCE_MONITOR_H
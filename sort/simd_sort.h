@@ -0,0 +1,266 @@
+#ifndef SORT_SIMD_SORT_H
+#define SORT_SIMD_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIMD_SORT_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+// Partitions of up to SIMD_SORT_KERNEL_MAX keys are sorted by a bitonic
+// network on vector registers: AVX-512 (8 keys per register) or AVX2
+// (4 keys), picked once at runtime from CPUID. Larger ranges are split by
+// quicksort until they fit, and CPUs without AVX2 fall back to std::sort.
+// The base case was tuned against std::sort on uniform and 10-key inputs.
+const size_t SIMD_SORT_KERNEL_MAX = 2048;
+const size_t SIMD_SORT_BASE_CASE = 2048;
+
+typedef void (*SmallSortKernel)(size_t *data, size_t size);
+
+inline size_t bitonicSize(size_t size) {
+    size_t padded = 16;
+    while (padded < size) padded <<= 1;
+    return padded;
+}
+
+#ifdef SIMD_SORT_X86
+
+SIMD_TARGET("avx2") inline __m256i greaterAvx2(__m256i a, __m256i b) {
+    const __m256i sign = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+    return _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+}
+
+// Bitonic sort of block[0..padded) with 4 keys per register. Steps with a
+// partner distance of at least one register compare whole registers; shorter
+// distances permute lanes inside a register and blend min/max per lane.
+SIMD_TARGET("avx2") inline void bitonicSortAvx2(size_t *block, size_t padded) {
+    const size_t width = 4;
+    const __m256i ones = _mm256_set1_epi64x(-1);
+
+    for (size_t k = 2; k <= padded; k <<= 1) {
+        for (size_t j = k >> 1; j > 0; j >>= 1) {
+            if (j >= width) {
+                for (size_t base = 0; base < padded; base += 2 * j) {
+                    bool descending = (base & k) != 0;
+                    for (size_t l = base; l < base + j; l += width) {
+                        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + l));
+                        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + l + j));
+                        __m256i greater = greaterAvx2(x, y);
+                        __m256i low = _mm256_blendv_epi8(x, y, greater);
+                        __m256i high = _mm256_blendv_epi8(y, x, greater);
+                        _mm256_storeu_si256(reinterpret_cast<__m256i *>(block + l), descending ? high : low);
+                        _mm256_storeu_si256(reinterpret_cast<__m256i *>(block + l + j), descending ? low : high);
+                    }
+                }
+                continue;
+            }
+
+            int partner[8];
+            long long takeMax[4];
+            for (int lane = 0; lane < 4; ++lane) {
+                int other = lane ^ static_cast<int>(j);
+                partner[2 * lane] = 2 * other;
+                partner[2 * lane + 1] = 2 * other + 1;
+                bool upper = (lane & j) != 0;
+                bool laneDescending = k < width && (lane & k) != 0;
+                takeMax[lane] = (upper != laneDescending) ? -1 : 0;
+            }
+            __m256i permutation = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(partner));
+            __m256i ascendingMask = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(takeMax));
+            __m256i descendingMask = _mm256_xor_si256(ascendingMask, ones);
+
+            for (size_t l = 0; l < padded; l += width) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + l));
+                __m256i y = _mm256_permutevar8x32_epi32(x, permutation);
+                __m256i greater = greaterAvx2(x, y);
+                __m256i low = _mm256_blendv_epi8(x, y, greater);
+                __m256i high = _mm256_blendv_epi8(y, x, greater);
+                __m256i mask = (k >= width && (l & k)) ? descendingMask : ascendingMask;
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(block + l), _mm256_blendv_epi8(low, high, mask));
+            }
+        }
+    }
+}
+
+// GCC 12 flags the undefined passthrough operand inside the masked AVX-512
+// min/max/permute intrinsics as maybe-uninitialized.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+SIMD_TARGET("avx512f") inline void bitonicSortAvx512(size_t *block, size_t padded) {
+    const size_t width = 8;
+
+    for (size_t k = 2; k <= padded; k <<= 1) {
+        for (size_t j = k >> 1; j > 0; j >>= 1) {
+            if (j >= width) {
+                for (size_t base = 0; base < padded; base += 2 * j) {
+                    bool descending = (base & k) != 0;
+                    for (size_t l = base; l < base + j; l += width) {
+                        __m512i x = _mm512_loadu_si512(block + l);
+                        __m512i y = _mm512_loadu_si512(block + l + j);
+                        __m512i low = _mm512_min_epu64(x, y);
+                        __m512i high = _mm512_max_epu64(x, y);
+                        _mm512_storeu_si512(block + l, descending ? high : low);
+                        _mm512_storeu_si512(block + l + j, descending ? low : high);
+                    }
+                }
+                continue;
+            }
+
+            long long partner[8];
+            __mmask8 ascendingMask = 0;
+            for (int lane = 0; lane < 8; ++lane) {
+                partner[lane] = lane ^ static_cast<int>(j);
+                bool upper = (lane & j) != 0;
+                bool laneDescending = k < width && (lane & k) != 0;
+                if (upper != laneDescending) ascendingMask |= static_cast<__mmask8>(1u << lane);
+            }
+            __m512i permutation = _mm512_loadu_si512(partner);
+            __mmask8 descendingMask = static_cast<__mmask8>(~ascendingMask);
+
+            for (size_t l = 0; l < padded; l += width) {
+                __m512i x = _mm512_loadu_si512(block + l);
+                __m512i y = _mm512_permutexvar_epi64(permutation, x);
+                __m512i low = _mm512_min_epu64(x, y);
+                __m512i high = _mm512_max_epu64(x, y);
+                __mmask8 mask = (k >= width && (l & k)) ? descendingMask : ascendingMask;
+                _mm512_storeu_si512(block + l, _mm512_mask_blend_epi64(mask, low, high));
+            }
+        }
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Pads data to a power of two with the largest key, sorts, and copies back.
+template<void (*Network)(size_t *, size_t)>
+void bitonicKernel(size_t *data, size_t size) {
+    alignas(64) size_t block[SIMD_SORT_KERNEL_MAX];
+    size_t padded = bitonicSize(size);
+    std::copy(data, data + size, block);
+    std::fill(block + size, block + padded, std::numeric_limits<size_t>::max());
+    Network(block, padded);
+    std::copy(block, block + size, data);
+}
+
+enum class SimdLevel {
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+inline SimdLevel detectSimdLevel() {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SimdLevel::Avx512;
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+    return SimdLevel::Scalar;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return SimdLevel::Scalar;
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27))) return SimdLevel::Scalar;
+    // The OS must save YMM state (XCR0 bits 1-2), and ZMM state (bits 5-7) for AVX-512.
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if ((info[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6) return SimdLevel::Avx512;
+    if ((info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6) return SimdLevel::Avx2;
+    return SimdLevel::Scalar;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+#endif
+
+// Kernel for this CPU, or nullptr when only the scalar fallback is available.
+inline SmallSortKernel selectSmallSortKernel() {
+#ifdef SIMD_SORT_X86
+    if (sizeof(size_t) == 8) {
+        SimdLevel level = detectSimdLevel();
+        if (level == SimdLevel::Avx512) return bitonicKernel<bitonicSortAvx512>;
+        if (level == SimdLevel::Avx2) return bitonicKernel<bitonicSortAvx2>;
+    }
+#endif
+    return nullptr;
+}
+
+inline SmallSortKernel smallSortKernel() {
+    static const SmallSortKernel kernel = selectSmallSortKernel();
+    return kernel;
+}
+
+inline const char *smallSortKernelName() {
+#ifdef SIMD_SORT_X86
+    SmallSortKernel kernel = smallSortKernel();
+    if (kernel == bitonicKernel<bitonicSortAvx512>) return "avx512";
+    if (kernel == bitonicKernel<bitonicSortAvx2>) return "avx2";
+#endif
+    return "scalar";
+}
+
+// Median of three moved to *first, then the unguarded Hoare partition of
+// libstdc++'s introsort; depthLimit bounds the recursion before heapsort.
+inline void simdIntroSort(size_t *first, size_t *last, size_t depthLimit, SmallSortKernel kernel) {
+    while (static_cast<size_t>(last - first) > SIMD_SORT_BASE_CASE) {
+        if (depthLimit == 0) {
+            std::make_heap(first, last);
+            std::sort_heap(first, last);
+            return;
+        }
+        --depthLimit;
+
+        size_t *a = first + 1, *b = first + (last - first) / 2, *c = last - 1;
+        size_t *median = (*a < *b) ? ((*b < *c) ? b : (*a < *c ? c : a))
+                                   : ((*a < *c) ? a : (*b < *c ? c : b));
+        std::iter_swap(first, median);
+
+        size_t pivot = *first;
+        size_t *low = first + 1, *high = last;
+        while (true) {
+            while (*low < pivot) ++low;
+            --high;
+            while (pivot < *high) --high;
+            if (!(low < high)) break;
+            std::iter_swap(low, high);
+            ++low;
+        }
+
+        simdIntroSort(low, last, depthLimit, kernel);
+        last = low;
+    }
+    // Leaves made of one repeated key are common with low-cardinality input.
+    if (!std::is_sorted(first, last)) kernel(first, static_cast<size_t>(last - first));
+}
+
+// Ascending sort of size_t keys; drop-in for std::sort(data, data + size).
+inline void simdSort(size_t *data, size_t size) {
+    SmallSortKernel kernel = smallSortKernel();
+    if (!kernel) {
+        std::sort(data, data + size);
+        return;
+    }
+    size_t depthLimit = 0;
+    for (size_t n = size; n > 1; n >>= 1) depthLimit += 2;
+    simdIntroSort(data, data + size, depthLimit, kernel);
+}
+
+#endif //SORT_SIMD_SORT_H
@@ -0,0 +1,47 @@
+#ifndef SORT_SORT_ENGINE_H
+#define SORT_SORT_ENGINE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include "adaptive_sort.h"
+#include "parallel_sort.h"
+#include "radix_sort.h"
+#include "task_pool.h"
+
+enum class SortEngine {
+    Merge,
+    Radix,
+    Adaptive
+};
+
+// adaptiveStats, when given, receives the run statistics of the adaptive engine.
+inline void sortInMemory(SortEngine engine, size_t *arr, size_t *buffer, size_t size, size_t numThreads, TaskPool &pool,
+                         AdaptiveSortStats *adaptiveStats = nullptr) {
+    numThreads = std::min(numThreads, size);
+    if (numThreads == 0) return;
+    if (engine == SortEngine::Radix) {
+        radixSort(arr, buffer, size, numThreads, pool);
+    } else if (engine == SortEngine::Adaptive) {
+        AdaptiveSortStats stats = adaptiveSort(arr, buffer, size, numThreads, pool);
+        if (adaptiveStats) *adaptiveStats = stats;
+    } else {
+        sortAndMerge(arr, buffer, size, numThreads, pool);
+    }
+}
+
+inline const char *engineName(SortEngine engine) {
+    if (engine == SortEngine::Radix) return "radix";
+    if (engine == SortEngine::Adaptive) return "adaptive";
+    return "merge";
+}
+
+inline bool parseEngine(const std::string &name, SortEngine &engine) {
+    if (name == "merge") engine = SortEngine::Merge;
+    else if (name == "radix") engine = SortEngine::Radix;
+    else if (name == "adaptive") engine = SortEngine::Adaptive;
+    else return false;
+    return true;
+}
+
+#endif //SORT_SORT_ENGINE_H
@@ -0,0 +1,243 @@
+#ifndef SORT_TASK_POOL_H
+#define SORT_TASK_POOL_H
+
+#include <cstddef>
+#include <functional>
+
+typedef void (*TaskCallback)(void *param);
+// Runs on each worker thread before it takes tasks, e.g. to pin it to a core.
+typedef std::function<void(size_t worker)> WorkerStartCallback;
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <deque>
+
+// Win32 backend: every submitted task becomes a PTP_WORK item in a private
+// threadpool capped at numThreads threads. Threadpool threads are not ours to
+// place, so worker start callbacks and worker hints are ignored.
+class TaskPool {
+public:
+    explicit TaskPool(size_t numThreads, const WorkerStartCallback & = WorkerStartCallback())
+            : numThreads(numThreads) {
+        pool = CreateThreadpool(NULL);
+        SetThreadpoolThreadMaximum(pool, static_cast<DWORD>(numThreads));
+        SetThreadpoolThreadMinimum(pool, 0);
+
+        cleanupGroup = CreateThreadpoolCleanupGroup();
+        InitializeThreadpoolEnvironment(&callbackEnviron);
+        SetThreadpoolCallbackPool(&callbackEnviron, pool);
+        SetThreadpoolCallbackCleanupGroup(&callbackEnviron, cleanupGroup, NULL);
+    }
+
+    ~TaskPool() {
+        wait();
+        CloseThreadpoolCleanupGroupMembers(cleanupGroup, FALSE, NULL);
+        CloseThreadpoolCleanupGroup(cleanupGroup);
+        CloseThreadpool(pool);
+        DestroyThreadpoolEnvironment(&callbackEnviron);
+    }
+
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
+
+    size_t threadCount() const { return numThreads; }
+
+    void submit(TaskCallback callback, void *param) {
+        tasks.push_back({callback, param, NULL});
+        Task &task = tasks.back();
+        task.work = CreateThreadpoolWork(WorkCallback, &task, &callbackEnviron);
+        SubmitThreadpoolWork(task.work);
+    }
+
+    void submit(TaskCallback callback, void *param, size_t) {
+        submit(callback, param);
+    }
+
+    void wait() {
+        for (auto &task : tasks) {
+            WaitForThreadpoolWorkCallbacks(task.work, FALSE);
+            CloseThreadpoolWork(task.work);
+        }
+        tasks.clear();
+    }
+
+private:
+    struct Task {
+        TaskCallback callback;
+        void *param;
+        PTP_WORK work;
+    };
+
+    static VOID CALLBACK WorkCallback(PTP_CALLBACK_INSTANCE, PVOID context, PTP_WORK) {
+        auto *task = static_cast<Task *>(context);
+        task->callback(task->param);
+    }
+
+    size_t numThreads;
+    PTP_POOL pool{};
+    PTP_CLEANUP_GROUP cleanupGroup{};
+    TP_CALLBACK_ENVIRON callbackEnviron{};
+    std::deque<Task> tasks;
+};
+
+#else
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// std::thread backend: numThreads workers, each owning a deque. Workers pop
+// their own deque from the back and steal from the front of the others.
+// A pool built with a worker start callback (placed workers) also keeps a
+// private queue per worker for tasks that must run on that worker.
+class TaskPool {
+public:
+    explicit TaskPool(size_t numThreads, WorkerStartCallback onWorkerStart = WorkerStartCallback())
+            : numThreads(numThreads), onWorkerStart(std::move(onWorkerStart)) {
+        for (size_t i = 0; i < numThreads; ++i) queues.emplace_back(new WorkQueue);
+        for (size_t i = 0; i < numThreads; ++i) workers.emplace_back(&TaskPool::workerLoop, this, i);
+    }
+
+    ~TaskPool() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+        for (auto &worker : workers) worker.join();
+    }
+
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
+
+    size_t threadCount() const { return numThreads; }
+
+    void submit(TaskCallback callback, void *param) {
+        size_t target = (currentPool == this) ? currentWorker : nextQueue++ % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[target]->mutex);
+            queues[target]->tasks.push_back({callback, param});
+        }
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            ++pending;
+            ++queued;
+        }
+        wakeCondition.notify_one();
+    }
+
+    // Runs the task on the given worker when workers are placed, so data it
+    // touches first stays local to that worker; otherwise same as submit().
+    void submit(TaskCallback callback, void *param, size_t worker) {
+        if (!onWorkerStart) {
+            submit(callback, param);
+            return;
+        }
+        WorkQueue &queue = *queues[worker % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.pinnedTasks.push_back({callback, param});
+        }
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            ++pending;
+            ++queue.pinned;
+        }
+        wakeCondition.notify_all();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        doneCondition.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    struct Task {
+        TaskCallback callback;
+        void *param;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::deque<Task> pinnedTasks;
+        std::atomic<long> pinned{0};
+    };
+
+    bool popTask(size_t self, Task &task) {
+        {
+            std::lock_guard<std::mutex> lock(queues[self]->mutex);
+            if (!queues[self]->pinnedTasks.empty()) {
+                task = queues[self]->pinnedTasks.front();
+                queues[self]->pinnedTasks.pop_front();
+                queues[self]->pinned.fetch_sub(1);
+                return true;
+            }
+            if (!queues[self]->tasks.empty()) {
+                task = queues[self]->tasks.back();
+                queues[self]->tasks.pop_back();
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < queues.size(); ++offset) {
+            WorkQueue &victim = *queues[(self + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(size_t self) {
+        currentPool = this;
+        currentWorker = self;
+        if (onWorkerStart) onWorkerStart(self);
+
+        while (true) {
+            Task task{};
+            if (popTask(self, task)) {
+                task.callback(task.param);
+
+                std::lock_guard<std::mutex> lock(stateMutex);
+                if (--pending == 0) doneCondition.notify_all();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(stateMutex);
+            WorkQueue &own = *queues[self];
+            wakeCondition.wait(lock, [&] { return stopping || queued.load() > 0 || own.pinned.load() > 0; });
+            if (stopping && queued.load() <= 0 && own.pinned.load() <= 0) return;
+        }
+    }
+
+    size_t numThreads;
+    WorkerStartCallback onWorkerStart;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue{0};
+
+    std::mutex stateMutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    std::atomic<long> queued{0};
+    size_t pending = 0;
+    bool stopping = false;
+
+    static inline thread_local TaskPool *currentPool = nullptr;
+    static inline thread_local size_t currentWorker = 0;
+};
+
+#endif
+
+#endif //SORT_TASK_POOL_H